@@ -53,6 +53,10 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
@@ -65,6 +69,13 @@ struct block_operations
 {
   void (*read) (void *aux, block_sector_t, void *buffer);
   void (*write) (void *aux, block_sector_t, const void *buffer);
+
+  /* Transfer CNT consecutive sectors in a single request.
+     Optional; if null, the sectors are transferred one by one. */
+  void (*read_multiple) (void *aux, block_sector_t, block_sector_t cnt,
+                         void *buffer);
+  void (*write_multiple) (void *aux, block_sector_t, block_sector_t cnt,
+                          const void *buffer);
 };
 
 struct block *block_register (const char *name, enum block_type,
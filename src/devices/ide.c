@@ -85,7 +85,8 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -336,22 +337,90 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
+/* Maximum number of sectors transferred by a single ATA command. */
+#define MAX_SECTORS_PER_COMMAND 256
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Issues
+   a single READ SECTOR command for up to 256 sectors at a time.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                   void *buffer_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
+  block_sector_t chunk, i;
+
+  lock_acquire (&c->lock);
+  for (; cnt > 0; cnt -= chunk, sec_no += chunk)
+    {
+      chunk = cnt < MAX_SECTORS_PER_COMMAND ? cnt : MAX_SECTORS_PER_COMMAND;
+      select_sector (d, sec_no, chunk);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+
+      /* The disk interrupts once for every sector it has ready. */
+      for (i = 0; i < chunk; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%" PRDSNu, d->name,
+                   sec_no + i);
+          input_sector (c, buffer);
+          buffer += BLOCK_SECTOR_SIZE;
+        }
+    }
+  lock_release (&c->lock);
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
 ide_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d_, sec_no, 1, buffer);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Issues a
+   single WRITE SECTOR command for up to 256 sectors at a time.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                    const void *buffer_)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
+  block_sector_t chunk, i;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  for (; cnt > 0; cnt -= chunk, sec_no += chunk)
+    {
+      chunk = cnt < MAX_SECTORS_PER_COMMAND ? cnt : MAX_SECTORS_PER_COMMAND;
+      select_sector (d, sec_no, chunk);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+
+      /* The disk interrupts once it is ready for each following sector,
+         and once more when the last one has been written. */
+      for (i = 0; i < chunk; i++)
+        {
+          if (i > 0)
+            sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%" PRDSNu, d->name,
+                   sec_no + i);
+          output_sector (c, buffer);
+          buffer += BLOCK_SECTOR_SIZE;
+        }
+      sema_down (&c->completion_wait);
+    }
   lock_release (&c->lock);
 }
 
@@ -363,32 +432,25 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
 static void
 ide_write (void *d_, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  ide_write_multiple (d_, sec_no, 1, buffer);
 }
 
-static struct block_operations ide_operations = { ide_read, ide_write };
+static struct block_operations ide_operations
+    = { ide_read, ide_write, ide_read_multiple, ide_write_multiple };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the number of sectors to transfer, CNT, to
+   the disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_COMMAND);
 
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt % MAX_SECTORS_PER_COMMAND);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -11,8 +11,20 @@
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/fault.h"
+#include "vm/pageout.h"
+#include "vm/slab.h"
+#include "vm/swap.h"
+#include "vm/text.h"
+#include "vm/vmm.h"
+#include "vm/writeback.h"
+#include "vm/wset.h"
+#include "vm/zswap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -131,12 +143,26 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+#ifdef VM
+  fault_print_stats ();
+#endif
 #ifdef FILESYS
   block_print_stats ();
+  cache_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  swap_print_stats ();
+  zswap_print_stats ();
+  pageout_print_stats ();
+  writeback_print_stats ();
+  wset_print_stats ();
+  slab_print_stats ();
+  text_print_stats ();
+  vmm_print_stats ();
+#endif
 }
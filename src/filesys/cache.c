@@ -0,0 +1,387 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.
+
+   Holds up to CACHE_SIZE sectors of the file system device.
+   Reads and writes of the inode layer go through it, so that
+   sectors accessed repeatedly, such as directory and inode
+   sectors, are read from disk only once.  Writes only mark a
+   sector dirty; dirty sectors are written back when they are
+   evicted, by the flush daemon every CACHE_FLUSH_INTERVAL ticks,
+   and by filesys_done().  Victims are chosen with the clock
+   algorithm.
+
+   Sectors that readers are expected to need soon can be queued
+   with cache_read_ahead().  The read-ahead daemon brings them in
+   in the background, so that the disk works while the reader
+   computes.  Requests that find the queue full are dropped.
+
+   CACHE_LOCK protects the table: which sector each entry holds,
+   the pin counts, the accessed bits, and the clock hand.  The
+   lock of an entry protects its data and is held across its
+   disk I/O.  A pinned entry keeps its sector, so its lock may
+   be acquired after releasing CACHE_LOCK.  CACHE_LOCK is never
+   acquired while waiting for the lock of an entry. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Ticks between runs of the flush daemon. */
+#define CACHE_FLUSH_INTERVAL TIMER_FREQ
+
+/* Maximum number of queued read-ahead requests. */
+#define READAHEAD_QUEUE_SIZE 32
+
+/* Sector number of an unused entry. */
+#define NO_SECTOR ((block_sector_t) -1)
+
+/* A cached sector. */
+struct cache_entry
+{
+  block_sector_t sector;           /* Sector held, or NO_SECTOR. */
+  int pin_cnt;                     /* Number of users of the entry. */
+  bool accessed;                   /* Used since the clock hand passed? */
+  struct lock lock;                /* Protects the members below. */
+  bool valid;                      /* Has DATA been read from disk? */
+  bool dirty;                      /* Has DATA been written to? */
+  uint8_t data[BLOCK_SECTOR_SIZE]; /* Contents of the sector. */
+};
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static size_t clock_hand;
+
+/* Read-ahead queue, a ring of sectors. */
+static block_sector_t readahead_queue[READAHEAD_QUEUE_SIZE];
+static size_t readahead_head;           /* Index of the oldest request. */
+static size_t readahead_cnt;            /* Number of queued requests. */
+static struct lock readahead_lock;      /* Protects the queue. */
+static struct condition readahead_cond; /* Signaled on new requests. */
+
+/* Statistics. */
+static long long hit_cnt;       /* Accesses to cached sectors. */
+static long long miss_cnt;      /* Accesses that had to read a sector. */
+static long long writeback_cnt; /* Dirty sectors written back. */
+static long long prefetch_cnt;  /* Sectors read ahead. */
+static long long drop_cnt;      /* Read-ahead requests dropped. */
+
+static thread_func flush_daemon NO_RETURN;
+static thread_func readahead_daemon NO_RETURN;
+
+/* Initializes the buffer cache and starts its flush daemon. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].sector = NO_SECTOR;
+      cache[i].pin_cnt = 0;
+      cache[i].accessed = false;
+      lock_init (&cache[i].lock);
+      cache[i].valid = false;
+      cache[i].dirty = false;
+    }
+  clock_hand = 0;
+  lock_init (&readahead_lock);
+  cond_init (&readahead_cond);
+  readahead_head = readahead_cnt = 0;
+  thread_create ("cache flush", PRI_DEFAULT, flush_daemon, NULL);
+  thread_create ("readahead", PRI_DEFAULT, readahead_daemon, NULL);
+}
+
+/* Writes E back to disk if it is dirty.
+   The caller must hold E's lock. */
+static void
+write_back (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      e->dirty = false;
+      writeback_cnt++;
+    }
+}
+
+/* Unpins E. */
+static void
+unpin (struct cache_entry *e)
+{
+  lock_acquire (&cache_lock);
+  e->pin_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry that holds SECTOR, or a null pointer if
+   there is none.  The caller must hold CACHE_LOCK. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Returns an entry for a new sector, chosen with the clock
+   algorithm among the unpinned ones, or a null pointer if a
+   dirty victim was written back instead and the caller must
+   look again.  The caller must hold CACHE_LOCK, which may be
+   released and reacquired. */
+static struct cache_entry *
+find_victim (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two sweeps clear every accessed bit along the way. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (e->pin_cnt > 0)
+        continue;
+      if (e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+      if (e->dirty)
+        {
+          /* Write the victim back before it may be reused, so
+             that nobody reads the stale sector from disk. */
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          lock_acquire (&e->lock);
+          write_back (e);
+          lock_release (&e->lock);
+          lock_acquire (&cache_lock);
+          e->pin_cnt--;
+          return NULL;
+        }
+      return e;
+    }
+
+  /* Every entry is pinned.  Let their users finish. */
+  lock_release (&cache_lock);
+  thread_yield ();
+  lock_acquire (&cache_lock);
+  return NULL;
+}
+
+/* Returns the entry for SECTOR, pinned and with its lock held,
+   bringing the sector into the cache if necessary.  The entry's
+   data is valid unless the caller is about to overwrite all of
+   it, as indicated by OVERWRITE. */
+static struct cache_entry *
+get_entry (block_sector_t sector, bool overwrite)
+{
+  struct cache_entry *e;
+
+  ASSERT (sector != NO_SECTOR);
+
+  /* Another thread may bring the sector in whenever CACHE_LOCK
+     is released, so look it up again each time. */
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = lookup (sector);
+      if (e != NULL)
+        {
+          hit_cnt++;
+          break;
+        }
+      e = find_victim ();
+      if (e != NULL)
+        {
+          e->sector = sector;
+          e->valid = false;
+          miss_cnt++;
+          break;
+        }
+    }
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  lock_acquire (&e->lock);
+  if (!e->valid && !overwrite)
+    {
+      block_read (fs_device, sector, e->data);
+      e->valid = true;
+    }
+  return e;
+}
+
+/* Releases E, obtained from get_entry(). */
+static void
+put_entry (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+  unpin (e);
+}
+
+/* Reads SIZE bytes at offset OFS of SECTOR into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = get_entry (sector, false);
+  memcpy (buffer, e->data + ofs, size);
+  put_entry (e);
+}
+
+/* Reads SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER at offset OFS of SECTOR.  The
+   sector reaches the disk later. */
+void
+cache_write_at (block_sector_t sector, const void *buffer, int ofs,
+                int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = get_entry (sector, size == BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->valid = true;
+  e->dirty = true;
+  put_entry (e);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER to SECTOR.  The
+   sector reaches the disk later. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes every dirty sector in the cache back to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_lock);
+      if (e->sector == NO_SECTOR || !e->dirty)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      write_back (e);
+      put_entry (e);
+    }
+}
+
+/* Writes dirty sectors back periodically, so that a crash loses
+   at most CACHE_FLUSH_INTERVAL ticks of writes. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (CACHE_FLUSH_INTERVAL);
+      cache_flush ();
+    }
+}
+
+/* Returns true if SECTOR is in the cache. */
+static bool
+is_cached (block_sector_t sector)
+{
+  bool cached;
+
+  lock_acquire (&cache_lock);
+  cached = lookup (sector) != NULL;
+  lock_release (&cache_lock);
+  return cached;
+}
+
+/* Queues SECTOR to be brought into the cache in the background,
+   unless it is already there. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  if (is_cached (sector))
+    return;
+
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_QUEUE_SIZE)
+    {
+      readahead_queue[(readahead_head + readahead_cnt++)
+                      % READAHEAD_QUEUE_SIZE] = sector;
+      cond_signal (&readahead_cond, &readahead_lock);
+    }
+  else
+    drop_cnt++;
+  lock_release (&readahead_lock);
+}
+
+/* Brings queued sectors into the cache. */
+static void
+readahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_QUEUE_SIZE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      /* The reader may have gotten there first. */
+      if (!is_cached (sector))
+        {
+          put_entry (get_entry (sector, false));
+          prefetch_cnt++;
+        }
+    }
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld sectors written back\n",
+          hit_cnt, miss_cnt, writeback_cnt);
+  printf ("Cache: %lld sectors read ahead, %lld requests dropped\n",
+          prefetch_cnt, drop_cnt);
+}
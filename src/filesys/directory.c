@@ -1,16 +1,57 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Directory index.
+
+   A directory is a flat array of `struct dir_entry'.  New
+   directories also have a hash index of their entries' names,
+   kept in a file of its own, so that looking up, adding and
+   removing a name take constant time on average instead of a
+   scan of the whole directory.
+
+   The first entry of an indexed directory is a header that is
+   not in use, named DIR_INDEX_NAME, whose INODE_SECTOR is the
+   inode of the index.  Code that only knows the flat format skips
+   it like any other free entry.  Directories without the header
+   are searched linearly, as before.
+
+   The index file starts with a `struct dir_index_header',
+   followed by BUCKET_CNT buckets that are searched with linear
+   probing.  A bucket holds 1 plus the slot of an entry in the
+   directory, BUCKET_EMPTY, or BUCKET_DELETED for an entry that
+   was removed.  Removed entries are linked into a free list
+   through their INODE_SECTOR members, so that adding a name
+   finds a free slot without a scan either.  The index is rebuilt
+   from the entries, at twice the size if needed, when three
+   quarters of its buckets are not empty. */
+
+/* Name of the header entry of an indexed directory. */
+#define DIR_INDEX_NAME "\177index"
+
+/* Identifies a directory index. */
+#define DIR_INDEX_MAGIC 0x44494458
+
+/* Smallest number of buckets in an index. */
+#define DIR_INDEX_MIN_BUCKETS 16
+
+/* Bucket values. */
+#define BUCKET_EMPTY 0            /* Never used. */
+#define BUCKET_DELETED UINT32_MAX /* Entry was removed. */
+
 /* A directory. */
 struct dir
 {
   struct inode *inode; /* Backing store. */
   off_t pos;           /* Current position. */
+  struct inode *index; /* Name index, or a null pointer if none. */
 };
 
 /* A single directory entry. */
@@ -21,12 +62,90 @@ struct dir_entry
   bool in_use;                 /* In use or free? */
 };
 
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+/* Start of a directory index file. */
+struct dir_index_header
+{
+  uint32_t magic;      /* DIR_INDEX_MAGIC. */
+  uint32_t bucket_cnt; /* Number of buckets, a power of 2. */
+  uint32_t entry_cnt;  /* Number of entries in use. */
+  uint32_t used_cnt;   /* Number of buckets that are not empty. */
+  uint32_t free_slot;  /* 1 plus the first free slot, or 0. */
+};
+
+/* Returns the byte offset of bucket I in an index file. */
+static inline off_t
+bucket_ofs (uint32_t i)
+{
+  return sizeof (struct dir_index_header) + i * sizeof (uint32_t);
+}
+
+/* Creates a directory for about ENTRY_CNT entries in the given
+   SECTOR, with a name index.  The directory grows as needed.
+   Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_index_header h;
+  struct dir_entry e;
+  block_sector_t index_sector;
+  struct inode *index = NULL;
+  struct inode *inode = NULL;
+  bool success;
+
+  h.magic = DIR_INDEX_MAGIC;
+  h.bucket_cnt = DIR_INDEX_MIN_BUCKETS;
+  while (h.bucket_cnt < 2 * entry_cnt)
+    h.bucket_cnt *= 2;
+  h.entry_cnt = h.used_cnt = h.free_slot = 0;
+
+  memset (&e, 0, sizeof e);
+  strlcpy (e.name, DIR_INDEX_NAME, sizeof e.name);
+  e.in_use = false;
+
+  if (!free_map_allocate (1, &index_sector))
+    return false;
+  e.inode_sector = index_sector;
+
+  success = (inode_create (index_sector, bucket_ofs (h.bucket_cnt))
+             && (index = inode_open (index_sector)) != NULL
+             && inode_write_at (index, &h, sizeof h, 0) == sizeof h
+             && inode_create (sector, sizeof e)
+             && (inode = inode_open (sector)) != NULL
+             && inode_write_at (inode, &e, sizeof e, 0) == sizeof e);
+  if (!success)
+    {
+      if (index != NULL)
+        inode_remove (index);
+      else
+        free_map_release (index_sector, 1);
+    }
+  inode_close (inode);
+  inode_close (index);
+  return success;
+}
+
+/* Opens the index of the directory in INODE.  Returns a null
+   pointer if it has none. */
+static struct inode *
+open_index (struct inode *inode)
+{
+  struct dir_entry e;
+  struct dir_index_header h;
+  struct inode *index;
+
+  if (inode_read_at (inode, &e, sizeof e, 0) != sizeof e || e.in_use
+      || strcmp (e.name, DIR_INDEX_NAME))
+    return NULL;
+
+  index = inode_open (e.inode_sector);
+  if (index != NULL
+      && (inode_read_at (index, &h, sizeof h, 0) != sizeof h
+          || h.magic != DIR_INDEX_MAGIC))
+    {
+      inode_close (index);
+      index = NULL;
+    }
+  return index;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -39,6 +158,7 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
+      dir->index = open_index (inode);
       return dir;
     }
   else
@@ -71,6 +191,7 @@ dir_close (struct dir *dir)
 {
   if (dir != NULL)
     {
+      inode_close (dir->index);
       inode_close (dir->inode);
       free (dir);
     }
@@ -83,6 +204,143 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Reads the header of DIR's index into *H.  Returns true if
+   successful, false on failure. */
+static bool
+read_header (const struct dir *dir, struct dir_index_header *h)
+{
+  return inode_read_at (dir->index, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Writes *H as the header of DIR's index.  Returns true if
+   successful, false on failure. */
+static bool
+write_header (struct dir *dir, const struct dir_index_header *h)
+{
+  return inode_write_at (dir->index, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Returns bucket I of DIR's index. */
+static uint32_t
+read_bucket (const struct dir *dir, uint32_t i)
+{
+  uint32_t b;
+
+  if (inode_read_at (dir->index, &b, sizeof b, bucket_ofs (i)) != sizeof b)
+    return BUCKET_EMPTY;
+  return b;
+}
+
+/* Sets bucket I of DIR's index to B.  Returns true if
+   successful, false on failure. */
+static bool
+write_bucket (struct dir *dir, uint32_t i, uint32_t b)
+{
+  return inode_write_at (dir->index, &b, sizeof b, bucket_ofs (i))
+         == sizeof b;
+}
+
+/* Reads the entry in SLOT of DIR into *E.  Returns true if
+   successful, false if there is no such slot. */
+static bool
+read_entry (const struct dir *dir, uint32_t slot, struct dir_entry *e)
+{
+  return inode_read_at (dir->inode, e, sizeof *e, slot * sizeof *e)
+         == sizeof *e;
+}
+
+/* Writes *E into SLOT of DIR.  Returns true if successful, false
+   on failure. */
+static bool
+write_entry (struct dir *dir, uint32_t slot, const struct dir_entry *e)
+{
+  return inode_write_at (dir->inode, e, sizeof *e, slot * sizeof *e)
+         == sizeof *e;
+}
+
+/* Searches the index of DIR for NAME.  If found, returns true,
+   sets *EP to the entry and *SLOTP to its slot, and sets *BUCKETP
+   to the bucket that refers to it if BUCKETP is non-null.
+   Otherwise, returns false.  H is the header of the index. */
+static bool
+index_find (const struct dir *dir, const struct dir_index_header *h,
+            const char *name, struct dir_entry *ep, uint32_t *slotp,
+            uint32_t *bucketp)
+{
+  uint32_t mask = h->bucket_cnt - 1;
+  uint32_t i = hash_string (name) & mask;
+  uint32_t probes;
+
+  for (probes = 0; probes < h->bucket_cnt; probes++, i = (i + 1) & mask)
+    {
+      uint32_t b = read_bucket (dir, i);
+
+      if (b == BUCKET_EMPTY)
+        break;
+      if (b != BUCKET_DELETED && read_entry (dir, b - 1, ep) && ep->in_use
+          && !strcmp (name, ep->name))
+        {
+          *slotp = b - 1;
+          if (bucketp != NULL)
+            *bucketp = i;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Adds SLOT, which holds NAME, to the index of DIR with header
+   *H.  Returns true if successful, false on failure. */
+static bool
+index_insert (struct dir *dir, struct dir_index_header *h, const char *name,
+              uint32_t slot)
+{
+  uint32_t mask = h->bucket_cnt - 1;
+  uint32_t i = hash_string (name) & mask;
+
+  for (;;)
+    {
+      uint32_t b = read_bucket (dir, i);
+
+      if (b == BUCKET_EMPTY || b == BUCKET_DELETED)
+        {
+          if (b == BUCKET_EMPTY)
+            h->used_cnt++;
+          return write_bucket (dir, i, slot + 1);
+        }
+      i = (i + 1) & mask;
+    }
+}
+
+/* Rebuilds the index of DIR with header *H from the entries of
+   DIR, with BUCKET_CNT buckets.  Returns true if successful,
+   false on failure. */
+static bool
+index_rebuild (struct dir *dir, struct dir_index_header *h,
+               uint32_t bucket_cnt)
+{
+  static uint32_t zeros[BLOCK_SECTOR_SIZE / sizeof (uint32_t)];
+  struct dir_entry e;
+  off_t ofs, end;
+  uint32_t slot;
+
+  end = bucket_ofs (bucket_cnt);
+  for (ofs = bucket_ofs (0); ofs < end; ofs += sizeof zeros)
+    {
+      off_t size = end - ofs < (off_t) sizeof zeros ? end - ofs
+                                                     : (off_t) sizeof zeros;
+      if (inode_write_at (dir->index, zeros, size, ofs) != size)
+        return false;
+    }
+
+  h->bucket_cnt = bucket_cnt;
+  h->used_cnt = 0;
+  for (slot = 1; read_entry (dir, slot, &e); slot++)
+    if (e.in_use && !index_insert (dir, h, e.name, slot))
+      return false;
+  return write_header (dir, h);
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -98,6 +356,21 @@ lookup (const struct dir *dir, const char *name, struct dir_entry *ep,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (dir->index != NULL)
+    {
+      struct dir_index_header h;
+      uint32_t slot;
+
+      if (!read_header (dir, &h)
+          || !index_find (dir, &h, name, &e, &slot, NULL))
+        return false;
+      if (ep != NULL)
+        *ep = e;
+      if (ofsp != NULL)
+        *ofsp = slot * sizeof e;
+      return true;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (e.in_use && !strcmp (name, e.name))
@@ -131,6 +404,74 @@ dir_lookup (const struct dir *dir, const char *name, struct inode **inode)
   return *inode != NULL;
 }
 
+/* Adds a file named NAME, whose inode is in sector INODE_SECTOR,
+   to indexed DIR, which does not contain a file by that name.
+   Returns true if successful, false on failure. */
+static bool
+index_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+{
+  struct dir_index_header h;
+  struct dir_entry e;
+  uint32_t slot;
+
+  if (!read_header (dir, &h))
+    return false;
+
+  /* Keep at least a quarter of the buckets empty, so that probe
+     sequences stay short.  Deleted buckets are dropped, too. */
+  if ((h.used_cnt + 1) * 4 > h.bucket_cnt * 3)
+    {
+      uint32_t bucket_cnt = h.bucket_cnt;
+      while ((h.entry_cnt + 1) * 2 > bucket_cnt)
+        bucket_cnt *= 2;
+      if (!index_rebuild (dir, &h, bucket_cnt))
+        return false;
+    }
+
+  /* Take a free slot, or append one. */
+  if (h.free_slot != 0)
+    {
+      slot = h.free_slot - 1;
+      if (!read_entry (dir, slot, &e))
+        return false;
+      h.free_slot = e.inode_sector;
+    }
+  else
+    slot = inode_length (dir->inode) / sizeof e;
+
+  e.in_use = true;
+  strlcpy (e.name, name, sizeof e.name);
+  e.inode_sector = inode_sector;
+  if (!write_entry (dir, slot, &e) || !index_insert (dir, &h, name, slot))
+    return false;
+  h.entry_cnt++;
+  return write_header (dir, &h);
+}
+
+/* Removes the entry for NAME from indexed DIR and sets *EP to
+   it.  Returns true if successful, false on failure. */
+static bool
+index_remove (struct dir *dir, const char *name, struct dir_entry *ep)
+{
+  struct dir_index_header h;
+  struct dir_entry e;
+  uint32_t slot, bucket;
+
+  if (!read_header (dir, &h)
+      || !index_find (dir, &h, name, ep, &slot, &bucket))
+    return false;
+
+  e = *ep;
+  e.in_use = false;
+  e.inode_sector = h.free_slot;
+  if (!write_entry (dir, slot, &e)
+      || !write_bucket (dir, bucket, BUCKET_DELETED))
+    return false;
+  h.free_slot = slot + 1;
+  h.entry_cnt--;
+  return write_header (dir, &h);
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
@@ -155,6 +496,10 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
+  /* Indexed directories find a free slot without a scan. */
+  if (dir->index != NULL)
+    return index_add (dir, name, inode_sector);
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -201,9 +546,17 @@ dir_remove (struct dir *dir, const char *name)
     goto done;
 
   /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
-    goto done;
+  if (dir->index != NULL)
+    {
+      if (!index_remove (dir, name, &e))
+        goto done;
+    }
+  else
+    {
+      e.in_use = false;
+      if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        goto done;
+    }
 
   /* Remove inode. */
   inode_remove (inode);
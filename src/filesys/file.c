@@ -3,12 +3,23 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Bounds of the read-ahead window, in bytes.  The window starts
+   at the minimum when a file is first read sequentially, and
+   doubles with every further sequential read. */
+#define READAHEAD_MIN (2 * BLOCK_SECTOR_SIZE)
+#define READAHEAD_MAX (32 * BLOCK_SECTOR_SIZE)
+
 /* An open file. */
 struct file
 {
   struct inode *inode; /* File's inode. */
   off_t pos;           /* Current position. */
   bool deny_write;     /* Has file_deny_write() been called? */
+
+  /* Sequential read detection. */
+  off_t ra_next;   /* Offset a sequential read would start at. */
+  off_t ra_end;    /* End of the bytes read ahead so far. */
+  off_t ra_window; /* Bytes to keep read ahead, 0 if not sequential. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +34,9 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
@@ -60,6 +74,41 @@ file_get_inode (struct file *file)
   return file->inode;
 }
 
+/* Notes that SIZE bytes were just read from FILE at OFFSET.  If
+   the read continued the previous one, queues the bytes that
+   follow to be read ahead in the background. */
+static void
+read_ahead (struct file *file, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+  off_t start;
+
+  if (size <= 0)
+    return;
+  if (offset != file->ra_next)
+    {
+      /* Random access: no read-ahead. */
+      file->ra_window = 0;
+      file->ra_end = end;
+      file->ra_next = end;
+      return;
+    }
+
+  if (file->ra_window == 0)
+    file->ra_window = READAHEAD_MIN;
+  else if (file->ra_window < READAHEAD_MAX)
+    file->ra_window *= 2;
+
+  /* Only queue what earlier reads did not. */
+  start = file->ra_end > end ? file->ra_end : end;
+  if (start < end + file->ra_window)
+    {
+      inode_read_ahead (file->inode, start, end + file->ra_window - start);
+      file->ra_end = end + file->ra_window;
+    }
+  file->ra_next = end;
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
@@ -69,6 +118,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size)
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,7 +131,9 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  read_ahead (file, file_ofs, bytes_read);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -19,6 +19,23 @@ free_map_init (void)
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
 }
 
+/* Writes the free map to disk after allocating CNT sectors
+   starting at SECTOR.  Only the part of the free map file that
+   holds their bits is written, through the buffer cache, which
+   takes it to disk later.  If it cannot be written, undoes the
+   allocation and returns false. */
+static bool
+commit_allocation (block_sector_t sector, size_t cnt)
+{
+  if (free_map_file != NULL
+      && !bitmap_write_range (free_map, free_map_file, sector, cnt))
+    {
+      bitmap_set_multiple (free_map, sector, cnt, false);
+      return false;
+    }
+  return true;
+}
+
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
@@ -28,24 +45,80 @@ bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
   block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
-    {
-      bitmap_set_multiple (free_map, sector, cnt, false);
-      sector = BITMAP_ERROR;
-    }
+  if (sector != BITMAP_ERROR && !commit_allocation (sector, cnt))
+    sector = BITMAP_ERROR;
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates up to CNT consecutive sectors starting at SECTOR, as
+   many as are free.  Returns the number of sectors allocated,
+   which is 0 if SECTOR itself is in use or past the end of the
+   device. */
+size_t
+free_map_allocate_at (block_sector_t sector, size_t cnt)
+{
+  size_t size = bitmap_size (free_map);
+  size_t n = 0;
+
+  while (n < cnt && sector + n < size && !bitmap_test (free_map, sector + n))
+    n++;
+  if (n == 0)
+    return 0;
+  bitmap_set_multiple (free_map, sector, n, true);
+  return commit_allocation (sector, n) ? n : 0;
+}
+
+/* Allocates CNT consecutive sectors if possible, and otherwise
+   the longest run of free sectors there is.  Stores the first
+   sector into *SECTORP and the number of sectors allocated into
+   *CNTP.  Returns false if no sector is free or the free map
+   could not be written. */
+bool
+free_map_allocate_run (size_t cnt, block_sector_t *sectorp, size_t *cntp)
+{
+  size_t size = bitmap_size (free_map);
+  size_t best_start = 0, best_cnt = 0;
+  size_t start;
+
+  ASSERT (cnt > 0);
+
+  /* Look for the longest free run, stopping at the first one
+     that is long enough. */
+  start = bitmap_scan (free_map, 0, 1, false);
+  while (start != BITMAP_ERROR && best_cnt < cnt)
+    {
+      size_t end = start;
+      while (end < size && end - start < cnt && !bitmap_test (free_map, end))
+        end++;
+      if (end - start > best_cnt)
+        {
+          best_start = start;
+          best_cnt = end - start;
+        }
+      start = end < size ? bitmap_scan (free_map, end, 1, false)
+                         : BITMAP_ERROR;
+    }
+  if (best_cnt == 0)
+    return false;
+
+  bitmap_set_multiple (free_map, best_start, best_cnt, true);
+  if (!commit_allocation (best_start, best_cnt))
+    return false;
+  *sectorp = best_start;
+  *cntp = best_cnt;
+  return true;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  if (free_map_file != NULL)
+    bitmap_write_range (free_map, free_map_file, sector, cnt);
 }
 
 /* Opens the free map file and reads it from disk. */
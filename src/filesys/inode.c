@@ -3,6 +3,7 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
@@ -10,14 +11,31 @@
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of extents in an inode. */
+#define EXTENT_CNT 62
+
+/* A run of consecutive data sectors. */
+struct extent
+{
+  block_sector_t start; /* First sector. */
+  uint32_t cnt;         /* Number of sectors. */
+};
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   The data of a file is held in up to EXTENT_CNT extents, in
+   file order.  A file grows by lengthening its last extent in
+   place where the sectors after it are free, and by adding an
+   extent elsewhere otherwise, so that files stay contiguous
+   where possible without requiring it. */
 struct inode_disk
 {
-  block_sector_t start; /* First data sector. */
-  off_t length;         /* File size in bytes. */
-  unsigned magic;       /* Magic number. */
-  uint32_t unused[125]; /* Not used. */
+  off_t length;                      /* File size in bytes. */
+  unsigned magic;                    /* Magic number. */
+  uint32_t extent_cnt;               /* Number of extents in use. */
+  struct extent extents[EXTENT_CNT]; /* Data sectors. */
+  uint32_t unused[1];                /* Not used. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -48,9 +66,109 @@ byte_to_sector (const struct inode *inode, off_t pos)
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+    {
+      const struct inode_disk *d = &inode->data;
+      size_t idx = pos / BLOCK_SECTOR_SIZE;
+      size_t i;
+
+      for (i = 0; i < d->extent_cnt; i++)
+        {
+          if (idx < d->extents[i].cnt)
+            return d->extents[i].start + idx;
+          idx -= d->extents[i].cnt;
+        }
+    }
+  return -1;
+}
+
+/* Returns the number of data sectors allocated to D. */
+static size_t
+allocated_sectors (const struct inode_disk *d)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < d->extent_cnt; i++)
+    cnt += d->extents[i].cnt;
+  return cnt;
+}
+
+/* Writes zeros to the CNT sectors starting at SECTOR. */
+static void
+zero_sectors (block_sector_t sector, size_t cnt)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    cache_write (sector + i, zeros);
+}
+
+/* Allocates zeroed data sectors to D until it has at least
+   SECTORS of them.  Returns false if the disk is full or D has
+   no extents left, in which case D keeps the sectors allocated
+   so far. */
+static bool
+extend (struct inode_disk *d, size_t sectors)
+{
+  size_t have = allocated_sectors (d);
+
+  while (have < sectors)
+    {
+      size_t want = sectors - have;
+      struct extent *last = (d->extent_cnt > 0
+                             ? &d->extents[d->extent_cnt - 1] : NULL);
+      block_sector_t start;
+      size_t cnt;
+
+      /* Prefer to continue the last extent. */
+      if (last != NULL
+          && (cnt = free_map_allocate_at (last->start + last->cnt, want)) > 0)
+        {
+          zero_sectors (last->start + last->cnt, cnt);
+          last->cnt += cnt;
+        }
+      else
+        {
+          if (d->extent_cnt == EXTENT_CNT
+              || !free_map_allocate_run (want, &start, &cnt))
+            return false;
+          zero_sectors (start, cnt);
+          d->extents[d->extent_cnt].start = start;
+          d->extents[d->extent_cnt].cnt = cnt;
+          d->extent_cnt++;
+        }
+      have += cnt;
+    }
+  return true;
+}
+
+/* Releases the data sectors of D past the first KEEP. */
+static void
+release_sectors (struct inode_disk *d, size_t keep)
+{
+  size_t have = 0;
+  size_t i, cnt = 0;
+
+  for (i = 0; i < d->extent_cnt; i++)
+    {
+      struct extent *e = &d->extents[i];
+
+      if (have >= keep)
+        free_map_release (e->start, e->cnt);
+      else
+        {
+          if (have + e->cnt > keep)
+            {
+              free_map_release (e->start + (keep - have),
+                                e->cnt - (keep - have));
+              e->cnt = keep - have;
+            }
+          cnt++;
+        }
+      have += e->cnt;
+    }
+  d->extent_cnt = cnt;
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -84,22 +202,15 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
+      if (extend (disk_inode, bytes_to_sectors (length)))
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0)
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-
-              for (i = 0; i < sectors; i++)
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write (sector, disk_inode);
           success = true;
         }
+      else
+        release_sectors (disk_inode, 0);
       free (disk_inode);
     }
   return success;
@@ -137,7 +248,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  cache_read (inode->sector, &inode->data);
   return inode;
 }
 
@@ -177,8 +288,7 @@ inode_close (struct inode *inode)
       if (inode->removed)
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length));
+          release_sectors (&inode->data, 0);
         }
 
       free (inode);
@@ -202,7 +312,6 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
   while (size > 0)
     {
@@ -220,51 +329,78 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* Copy the chunk out of the buffer cache. */
+      cache_read_at (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
+/* Queues the sectors of INODE that hold the SIZE bytes starting
+   at OFFSET to be read into the buffer cache in the background.
+   Bytes past the end of INODE are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+  off_t pos;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (pos = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); pos < end;
+       pos += BLOCK_SECTOR_SIZE)
+    cache_read_ahead (byte_to_sector (inode, pos));
+}
+
+/* Extends INODE for a write of the bytes from OFFSET up to END,
+   or as far toward END as the disk allows, and writes the inode
+   to disk.  If not even the byte at OFFSET can be allocated,
+   INODE is left as it was. */
+static void
+grow (struct inode *inode, off_t offset, off_t end)
+{
+  size_t old_sectors = allocated_sectors (&inode->data);
+  off_t allocated;
+
+  extend (&inode->data, bytes_to_sectors (end));
+  allocated = allocated_sectors (&inode->data) * BLOCK_SECTOR_SIZE;
+  if (allocated <= offset)
+    {
+      release_sectors (&inode->data, old_sectors);
+      return;
+    }
+  if (end > allocated)
+    end = allocated;
+  if (end > inode->data.length)
+    {
+      inode->data.length = end;
+      cache_write (inode->sector, &inode->data);
+    }
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk is full or an error occurs.  A
+   write past the end of INODE extends it, and the bytes between
+   the old end and OFFSET read as zeros. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset)
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
   if (inode->deny_write_cnt)
     return 0;
 
+  if (size > 0 && offset + size > inode_length (inode))
+    grow (inode, offset, offset + size);
+
   while (size > 0)
     {
       /* Sector to write, starting byte offset within sector. */
@@ -281,38 +417,16 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left)
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* Copy the chunk into the buffer cache.  A partial sector
+         is merged with the rest of it there. */
+      cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                      chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
   return bytes_written;
 }
@@ -358,6 +358,28 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the CNT bits of B starting at START to FILE, at the
+   offsets bitmap_write() writes them at, along with the other
+   bits that share their bytes.  Return true if successful, false
+   otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file, size_t start,
+                    size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  if (cnt == 0)
+    return true;
+  ofs = start / CHAR_BIT;
+  size = DIV_ROUND_UP (start + cnt, CHAR_BIT) - ofs;
+  return file_write_at (file, (const uint8_t *)b->bits + ofs, size, ofs)
+         == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
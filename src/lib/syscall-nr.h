@@ -28,7 +28,13 @@ enum
   SYS_MKDIR,   /* Create a directory. */
   SYS_READDIR, /* Reads a directory entry. */
   SYS_ISDIR,   /* Tests if a fd represents a directory. */
-  SYS_INUMBER  /* Returns the inode number for a fd. */
+  SYS_INUMBER, /* Returns the inode number for a fd. */
+
+  /* Extensions. */
+  SYS_FORK,     /* Duplicate this process. */
+  SYS_MSYNC,    /* Write a memory mapping back to its file. */
+  SYS_VMSTAT,   /* Report memory usage of this process. */
+  SYS_RSSLIMIT  /* Limit the resident set of this process. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -173,3 +173,27 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+bool
+msync (mapid_t mapid)
+{
+  return syscall1 (SYS_MSYNC, mapid);
+}
+
+bool
+vmstat (struct vmstat *stat)
+{
+  return syscall1 (SYS_VMSTAT, stat);
+}
+
+bool
+setrsslimit (int page_cnt)
+{
+  return syscall1 (SYS_RSSLIMIT, page_cnt);
+}
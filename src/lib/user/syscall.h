@@ -45,4 +45,21 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+bool msync (mapid_t);
+
+/* Memory usage of a process, in pages. */
+struct vmstat
+{
+  int rss;       /* Resident pages. */
+  int rss_limit; /* Limit on resident pages, 0 if none. */
+  int wss;       /* Pages touched in the last sampling period. */
+  int faults;    /* Page faults so far. */
+  int swapins;   /* Pages read back from swap so far. */
+};
+
+bool vmstat (struct vmstat *);
+bool setrsslimit (int page_cnt);
+
 #endif /* lib/user/syscall.h */
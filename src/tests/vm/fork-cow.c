@@ -0,0 +1,32 @@
+/* Forks with a page of data shared copy-on-write, then has the
+   parent and the child each write their own value to it, and
+   checks that each one sees only its own write. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int shared[1024];
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  /* Make the page resident before forking, so that it is shared. */
+  shared[0] = 1;
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* Whatever the parent wrote since the fork must not show. */
+      int before = shared[0];
+      shared[0] = 2;
+      exit (before * 10 + shared[0]);
+    }
+  CHECK (child != -1, "fork");
+
+  shared[0] = 3;
+  CHECK (wait (child) == 12, "wait for child (should return 12)");
+  CHECK (shared[0] == 3, "parent still sees its own write");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-cow) begin
+(fork-cow) fork
+(fork-cow) wait for child (should return 12)
+(fork-cow) parent still sees its own write
+(fork-cow) end
+EOF
+pass;
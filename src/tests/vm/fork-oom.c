@@ -0,0 +1,54 @@
+/* Forks recursively until fork() fails for lack of memory, then
+   does it again, and checks that the same depth is reached every
+   time.  Each process writes to a page of its own, so that forks
+   cost user memory as well as kernel memory.
+
+   If a process cannot be created, fork() must return -1, not
+   kill the caller or a valid PID. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define EXPECTED_DEPTH_TO_PASS 30
+#define EXPECTED_REPETITIONS 3
+#define PAGE_CNT 64
+
+static char pages[PAGE_CNT][4096];
+
+/* Forks a chain of processes below this one at DEPTH, and returns
+   the depth at which fork() failed. */
+static int
+descend (int depth)
+{
+  pid_t child;
+
+  pages[depth % PAGE_CNT][0] = depth;
+  child = fork ();
+  if (child == 0)
+    exit (descend (depth + 1));
+  if (child == -1)
+    return depth;
+  return wait (child);
+}
+
+void
+test_main (void)
+{
+  int expected_depth, depth;
+  int i;
+
+  expected_depth = descend (0);
+  if (expected_depth < EXPECTED_DEPTH_TO_PASS)
+    fail ("should have forked at least %d times, but forked %d times",
+          EXPECTED_DEPTH_TO_PASS, expected_depth);
+
+  for (i = 1; i < EXPECTED_REPETITIONS; i++)
+    {
+      depth = descend (0);
+      if (depth != expected_depth)
+        fail ("after run %d/%d, expected depth %d, actual depth %d", i,
+              EXPECTED_REPETITIONS, expected_depth, depth);
+    }
+  msg ("fork failed at the same depth %d times", EXPECTED_REPETITIONS);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-oom) begin
+(fork-oom) fork failed at the same depth 3 times
+(fork-oom) end
+EOF
+pass;
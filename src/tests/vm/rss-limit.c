@@ -0,0 +1,47 @@
+/* Limits the resident set of the process to a few pages more
+   than it already has, touches many more pages than that, and
+   checks that the resident set stays within the limit and that
+   the pages come back from swap with their data. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 128
+#define EXTRA_PAGES 16
+
+static char pages[PAGE_CNT][4096];
+
+void
+test_main (void)
+{
+  struct vmstat st;
+  int limit, swapins;
+  int i;
+
+  CHECK (!setrsslimit (-1), "setrsslimit (-1) (must fail)");
+
+  CHECK (vmstat (&st), "vmstat");
+  limit = st.rss + EXTRA_PAGES;
+  CHECK (setrsslimit (limit), "setrsslimit");
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i][0] = i;
+      vmstat (&st);
+      if (st.rss > limit)
+        fail ("%d resident pages after touching page %d, limit is %d",
+              st.rss, i, limit);
+    }
+  swapins = st.swapins;
+  msg ("touched %d pages", PAGE_CNT);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (pages[i][0] != (char) i)
+      fail ("page %d holds %d, not %d", i, pages[i][0], i);
+  msg ("read back %d pages", PAGE_CNT);
+
+  CHECK (vmstat (&st), "vmstat");
+  CHECK (st.rss <= limit, "resident set within limit");
+  CHECK (st.swapins > swapins, "pages were read back from swap");
+}
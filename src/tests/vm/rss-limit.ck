@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) setrsslimit (-1) (must fail)
+(rss-limit) vmstat
+(rss-limit) setrsslimit
+(rss-limit) touched 128 pages
+(rss-limit) read back 128 pages
+(rss-limit) vmstat
+(rss-limit) resident set within limit
+(rss-limit) pages were read back from swap
+(rss-limit) end
+EOF
+pass;
@@ -38,7 +38,14 @@
 #include "filesys/fsutil.h"
 #endif
 #ifdef VM
+#include "vm/fault.h"
+#include "vm/pageout.h"
 #include "vm/swap.h"
+#include "vm/text.h"
+#include "vm/vmm.h"
+#include "vm/writeback.h"
+#include "vm/wset.h"
+#include "vm/zswap.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -131,7 +138,14 @@ main (void)
 #endif
 
 #ifdef VM
+  vmm_init_zero_page ();
+  vmm_init_large_pages ();
+  text_init ();
   swap_init ();
+  pageout_init ();
+  writeback_init ();
+  wset_init ();
+  fault_init ();
 #endif
 
   printf ("Boot complete.\n");
@@ -257,6 +271,21 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-evict"))
+        {
+          if (value == NULL || !swap_select_policy (value))
+            PANIC ("unknown eviction policy `%s' (use -h for help)", value);
+        }
+      else if (!strcmp (name, "-readahead"))
+        vmm_set_readahead (atoi (value));
+      else if (!strcmp (name, "-faultaround"))
+        vmm_set_fault_around (atoi (value));
+      else if (!strcmp (name, "-stack"))
+        vmm_set_stack_reserve (atoi (value));
+      else if (!strcmp (name, "-rsslimit"))
+        vmm_set_default_rss_limit (atoi (value));
+      else if (!strcmp (name, "-zswap"))
+        zswap_set_limit (atoi (value));
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -380,6 +409,17 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -evict=POLICY      Use POLICY to choose frames to evict:\n"
+          "                     clock (default), twohand, clockpro, wsclock.\n"
+          "  -readahead=COUNT   Read ahead up to COUNT pages on swap-in.\n"
+          "  -faultaround=COUNT Map aligned windows of COUNT code pages\n"
+          "                     on a fault (default 16).\n"
+          "  -stack=COUNT       Reserve COUNT stack pages for a new process\n"
+          "                     and bring them in up front (default 4).\n"
+          "  -rsslimit=COUNT    Keep at most COUNT pages of a process\n"
+          "                     resident (default no limit).\n"
+          "  -zswap=COUNT       Keep up to COUNT pages of compressed swap\n"
+          "                     in memory before the swap device.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
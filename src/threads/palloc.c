@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,7 @@ struct pool
   struct lock lock;        /* Mutual exclusion. */
   struct bitmap *used_map; /* Bitmap of free pages. */
   uint8_t *base;           /* Base of pool. */
+  size_t free_cnt;         /* Number of free pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +41,7 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void adjust_free_cnt (struct pool *, size_t added, size_t removed);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -82,7 +85,10 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+    {
+      pages = pool->base + PGSIZE * page_idx;
+      adjust_free_cnt (pool, 0, page_cnt);
+    }
   else
     pages = NULL;
 
@@ -100,6 +106,50 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Like palloc_get_multiple(), but the physical address of the
+   first page is a multiple of ALIGN_CNT pages.  Returns a null
+   pointer if there is no such run of free pages, unless
+   PAL_ASSERT is set in FLAGS, in which case the kernel panics. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt,
+                    size_t align_cnt)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t pool_size = bitmap_size (pool->used_map);
+  void *pages = NULL;
+  size_t page_idx;
+
+  if (page_cnt == 0 || align_cnt == 0)
+    return NULL;
+
+  /* Index of the first page in the pool that is suitably aligned. */
+  page_idx = (align_cnt - vtop (pool->base) / PGSIZE % align_cnt) % align_cnt;
+
+  lock_acquire (&pool->lock);
+  for (; page_idx + page_cnt <= pool_size; page_idx += align_cnt)
+    if (bitmap_none (pool->used_map, page_idx, page_cnt))
+      {
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        pages = pool->base + PGSIZE * page_idx;
+        break;
+      }
+  lock_release (&pool->lock);
+
+  if (pages != NULL)
+    {
+      adjust_free_cnt (pool, 0, page_cnt);
+      if (flags & PAL_ZERO)
+        memset (pages, 0, PGSIZE * page_cnt);
+    }
+  else
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("palloc_get: out of pages");
+    }
+
+  return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -139,6 +189,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  adjust_free_cnt (pool, page_cnt, 0);
 }
 
 /* Frees the page at PAGE. */
@@ -148,6 +199,27 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool.  The count is
+   only a snapshot and may be stale by the time it is used. */
+size_t
+palloc_count_free (enum palloc_flags flags)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  return pool->free_cnt;
+}
+
+/* Returns the total number of pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_count_pages (enum palloc_flags flags)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  return bitmap_size (pool->used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -167,6 +239,7 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   lock_init (&p->lock);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  p->free_cnt = page_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +253,15 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Adds ADDED and subtracts REMOVED from the free page count of
+   POOL.  Pages may be freed with interrupts off while switching
+   threads, where the pool lock cannot be taken, so the count is
+   protected by disabling interrupts instead. */
+static void
+adjust_free_cnt (struct pool *pool, size_t added, size_t removed)
+{
+  enum intr_level old_level = intr_disable ();
+  pool->free_cnt = pool->free_cnt + added - removed;
+  intr_set_level (old_level);
+}
@@ -14,7 +14,11 @@ enum palloc_flags
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt,
+                          size_t align_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+size_t palloc_count_free (enum palloc_flags);
+size_t palloc_count_pages (enum palloc_flags);
 
 #endif /* threads/palloc.h */
@@ -70,6 +70,7 @@ pd_no (const void *va)
 #define PTE_U 0x4            /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20           /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40           /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80          /* 1=4 MB page, 0=page table (PDEs only). */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t
@@ -116,6 +117,25 @@ pte_create_user_stub (bool writable)
 {
   return (writable ? PTE_W : 0) | PTE_U;
 }
+
+/* Returns a PDE that maps the `PTSPAN` bytes from `page` on, which must be
+   aligned to `PTSPAN` physically, as a single large page usable by user
+   code.  If `writable` is true then it will be writable as well. */
+static inline uint32_t
+pde_create_large_user (void *page, bool writable)
+{
+  ASSERT ((vtop (page) & (PTSPAN - 1)) == 0);
+  return vtop (page) | PTE_PS | PTE_U | PTE_P | (writable ? PTE_W : 0);
+}
+
+/* Returns a pointer to the large page that PDE, which must be
+   present and map a large page, points to. */
+static inline void *
+pde_get_large_page (uint32_t pde)
+{
+  ASSERT ((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS));
+  return ptov (pde & ~(uint32_t)(PTSPAN - 1));
+}
 #endif
 
 /* Returns a pointer to the page that page table entry PTE points
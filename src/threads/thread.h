@@ -10,6 +10,8 @@
 #include <stdint.h>
 
 #ifdef VM
+#include "vm/fault.h"
+#include "vm/vma.h"
 #include <hash.h>
 #endif
 
@@ -150,11 +152,25 @@ struct thread
 #endif
 
 #ifdef VM
-  struct list frames;      /* Frame table. */
+  struct vma_tree vmas;    /* Virtual memory areas. */
   struct hash mmaps;       /* Mapping table. */
   struct list mmap_blocks; /* List of mmap_user_block. */
 
   void *esp_before_syscall; /* Stack pointer right before syscall. */
+  int64_t stack_grow_ticks; /* Time of the last stack growth. */
+  size_t stack_grow_pages;  /* Pages added by the last stack growth. */
+
+  /* Memory usage, in pages. */
+  size_t rss;           /* Pages mapped to resident frames. */
+  size_t rss_limit;     /* Limit on `rss`, 0 if there is none. */
+  size_t wss;           /* Pages referenced in the last sampling period. */
+  size_t wss_sample;    /* Pages referenced in the current period so far. */
+  long long fault_cnt;  /* Page faults taken. */
+  long long swapin_cnt; /* Pages read back from swap. */
+
+  /* Page fault profiling. */
+  struct fault_profile *fault_profile; /* Latency histograms, or NULL. */
+  enum fault_cause fault_cause;        /* Cause of the current fault. */
 #endif
 
   /* Owned by thread.c. */
@@ -8,6 +8,7 @@
 #include "userprog/process.h"
 
 #ifdef VM
+#include "vm/fault.h"
 #include "vm/vmm.h"
 #endif
 
@@ -132,6 +133,8 @@ page_fault (struct intr_frame *f)
 
 #ifdef VM
   struct thread *cur;
+  uint64_t start;
+  bool handled;
 #endif
 
   /* Obtain faulting address, the virtual address that was
@@ -172,15 +175,20 @@ page_fault (struct intr_frame *f)
     process_trigger_exit (-1);
 #else
   cur = thread_current ();
+  cur->fault_cnt++;
 
+  start = fault_begin ();
+  handled = false;
   if (not_present)
+    handled = vmm_handle_not_present (fault_addr, write)
+              || vmm_grow_stack (fault_addr,
+                                 user ? f->esp : cur->esp_before_syscall);
+  else if (write)
+    handled = vmm_handle_write_protect (fault_addr);
+  if (handled)
     {
-      if (vmm_handle_not_present (fault_addr))
-        return;
-      if (user && vmm_grow_stack (fault_addr, f->esp))
-        return;
-      else if (!user && vmm_grow_stack (fault_addr, cur->esp_before_syscall))
-        return;
+      fault_end (start);
+      return;
     }
 
   if (user)
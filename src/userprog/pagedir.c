@@ -6,6 +6,11 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+#ifdef VM
+#define CPUID_PSE 0x00000008 /* CPUID.1:EDX, page size extension. */
+#define CR4_PSE 0x00000010   /* Page size extension enable. */
+#endif
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
 
@@ -23,7 +28,7 @@ pagedir_create (void)
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  Large pages are left to whoever mapped them. */
 void
 pagedir_destroy (uint32_t *pd)
 {
@@ -34,7 +39,7 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P)
+    if ((*pde & PTE_P) && !(*pde & PTE_PS))
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -80,6 +85,10 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
         return NULL;
     }
 
+  /* A large page has no page table. */
+  if (*pde & PTE_PS)
+    return NULL;
+
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
   return &pt[pt_no (vaddr)];
@@ -126,9 +135,18 @@ void *
 pagedir_get_page (uint32_t *pd, const void *uaddr)
 {
   uint32_t *pte;
+#ifdef VM
+  uint32_t pde;
+#endif
 
   ASSERT (is_user_vaddr (uaddr));
 
+#ifdef VM
+  pde = pd[pd_no (uaddr)];
+  if ((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+    return pde_get_large_page (pde) + ((uintptr_t)uaddr & (PTSPAN - 1));
+#endif
+
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
@@ -285,4 +303,83 @@ pagedir_set_page_stub (uint32_t *pd, void *upage, bool writable)
   else
     return false;
 }
+
+/* Set the write bit of the present page `upage` in page directory `pd`
+   according to `writable`.  Does nothing if `upage` is not present. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable)
+{
+  uint32_t *pte;
+
+  ASSERT (is_user_vaddr (upage));
+
+  pte = lookup_page (pd, upage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t)PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
+/* Turn on large page support in the CPU.  Returns false if the CPU has no
+   such support. */
+bool
+pagedir_enable_large_pages (void)
+{
+  uint32_t eax, ebx, ecx, edx, cr4;
+
+  /* See [IA32-v2a] "CPUID--CPU Identification" for the PSE feature bit, and
+     [IA32-v3a] 2.5 "Control Registers" for CR4.PSE. */
+  asm volatile ("cpuid"
+                : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                : "a"(1));
+  if ((edx & CPUID_PSE) == 0)
+    return false;
+
+  asm volatile ("movl %%cr4, %0" : "=r"(cr4));
+  cr4 |= CR4_PSE;
+  asm volatile ("movl %0, %%cr4" : : "r"(cr4) : "memory");
+  return true;
+}
+
+/* Map the `PTSPAN` bytes from user virtual address `upage` on to the large
+   page at kernel virtual address `kpage` in page directory `pd`.  Both must be
+   aligned to `PTSPAN`, and `kpage` must be physically contiguous.  Returns
+   false if anything is mapped in the range already, or was at some point,
+   so that it still has a page table. */
+bool
+pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage, bool writable)
+{
+  uint32_t *pde;
+
+  ASSERT (((uintptr_t)upage & (PTSPAN - 1)) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  pde = pd + pd_no (upage);
+  if (*pde != 0)
+    return false;
+  *pde = pde_create_large_user (kpage, writable);
+  return true;
+}
+
+/* Remove the large page mapped at `upage` from page directory `pd`.  Does
+   nothing if no large page is mapped there. */
+void
+pagedir_clear_large_page (uint32_t *pd, void *upage)
+{
+  uint32_t *pde;
+
+  ASSERT (is_user_vaddr (upage));
+
+  pde = pd + pd_no (upage);
+  if (*pde & PTE_PS)
+    {
+      *pde = 0;
+      invalidate_pagedir (pd);
+    }
+}
 #endif
@@ -17,6 +17,10 @@ void pagedir_activate (uint32_t *pd);
 
 #ifdef VM
 bool pagedir_set_page_stub (uint32_t *pd, void *upage, bool rw);
+void pagedir_set_writable (uint32_t *pd, const void *upage, bool rw);
+bool pagedir_enable_large_pages (void);
+bool pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage, bool rw);
+void pagedir_clear_large_page (uint32_t *pd, void *upage);
 #endif
 
 #endif /* userprog/pagedir.h */
@@ -27,6 +27,9 @@
 #endif
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static void process_init_fd_ctx (void);
 
@@ -247,6 +250,111 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Duplicates the calling process, whose registers on entry to the kernel
+   are F.  The child shares the address space of the parent copy-on-write
+   and gets its own handles of the parent's open files, but no memory-mapped
+   files.  Returns the child's thread id, or TID_ERROR if the thread cannot
+   be created.  The caller must wait on the child's `load_sema` before
+   returning to user mode, as the child copies from its address space. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct intr_frame *if_;
+  tid_t tid;
+
+  if_ = malloc (sizeof *if_);
+  if (if_ == NULL)
+    return TID_ERROR;
+  *if_ = *f;
+
+  tid = thread_create (thread_current ()->name, PRI_DEFAULT, start_fork, if_);
+  if (tid == TID_ERROR)
+    free (if_);
+  return tid;
+}
+
+/* Give the current process its own handles of the files open in
+   PARENT, with the same file descriptors and positions. */
+static bool
+copy_files (struct thread *parent)
+{
+  struct process_context *ctx, *parent_ctx;
+  struct fd_context *fd_ctx, *parent_fd_ctx;
+  struct list_elem *el;
+
+  ctx = thread_current ()->process_ctx;
+  parent_ctx = parent->process_ctx;
+  for (el = list_begin (&parent_ctx->fd_ctx_list);
+       el != list_end (&parent_ctx->fd_ctx_list); el = list_next (el))
+    {
+      parent_fd_ctx = list_entry (el, struct fd_context, elem);
+      fd_ctx = palloc_get_page (PAL_ZERO);
+      if (fd_ctx == NULL)
+        return false;
+      fd_ctx->fd = parent_fd_ctx->fd;
+      fd_ctx->screen_out = parent_fd_ctx->screen_out;
+      fd_ctx->keyboard_in = parent_fd_ctx->keyboard_in;
+      list_push_back (&ctx->fd_ctx_list, &fd_ctx->elem);
+      if (parent_fd_ctx->file != NULL)
+        {
+          fd_ctx->file = file_reopen (parent_fd_ctx->file);
+          if (fd_ctx->file == NULL)
+            return false;
+          file_seek (fd_ctx->file, file_tell (parent_fd_ctx->file));
+        }
+    }
+
+  if (parent_ctx->exe_file != NULL)
+    {
+      ctx->exe_file = file_reopen (parent_ctx->exe_file);
+      if (ctx->exe_file == NULL)
+        return false;
+      file_deny_write (ctx->exe_file);
+    }
+  return true;
+}
+
+/* A thread function that copies the parent process, which is
+   blocked in the fork system call, and returns to user mode as
+   its child. */
+static void
+start_fork (void *if__)
+{
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+  bool success;
+
+  if_ = *(struct intr_frame *)if__;
+  free (if__);
+
+  success = vmm_init ();
+  if (success)
+    {
+      cur->pagedir = pagedir_create ();
+      success = cur->pagedir != NULL;
+    }
+  if (success)
+    {
+      process_activate ();
+      thread_acquire_fs_lock ();
+      success = copy_files (cur->parent)
+                && vmm_fork (cur->parent, cur->process_ctx->exe_file);
+      thread_release_fs_lock ();
+    }
+
+  cur->process_ctx->load_success = success;
+  sema_up (&cur->process_ctx->load_sema);
+  if (!success)
+    thread_exit ();
+
+  /* The child sees fork() return 0. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 static void
 process_init_fd_ctx (void)
 {
@@ -299,9 +407,6 @@ process_exit (void)
       file_close (fd_ctx->file);
       process_remove_fd_ctx (fd_ctx);
     }
-  if (cur->process_ctx->exe_file != NULL)
-    file_allow_write (cur->process_ctx->exe_file);
-  file_close (cur->process_ctx->exe_file);
   thread_release_fs_lock ();
 
 #ifdef VM
@@ -317,6 +422,13 @@ process_exit (void)
   vmm_destroy ();
 #endif
 
+  /* Pages of the executable are mapped until here. */
+  thread_acquire_fs_lock ();
+  if (cur->process_ctx->exe_file != NULL)
+    file_allow_write (cur->process_ctx->exe_file);
+  file_close (cur->process_ctx->exe_file);
+  thread_release_fs_lock ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -687,19 +799,17 @@ static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
               uint32_t zero_bytes, bool writable)
 {
-#ifdef VM
-  uint32_t pos;
-#endif
-
   ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-#ifndef VM
-  file_seek (file, ofs);
+#ifdef VM
+  /* The pages are read in when they are touched. */
+  return vmm_create_vma (upage, (read_bytes + zero_bytes) / PGSIZE, file, ofs,
+                         read_bytes, writable, true)
+         != NULL;
 #else
-  pos = 0;
-#endif
+  file_seek (file, ofs);
 
   while (read_bytes > 0 || zero_bytes > 0)
     {
@@ -709,7 +819,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-#ifndef VM
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -729,12 +838,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
           palloc_free_page (kpage);
           return false;
         }
-#else
-      if (!vmm_create_file_map (upage, file, writable, true, ofs + pos,
-                                page_read_bytes))
-        return false;
-      pos += page_read_bytes;
-#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -742,6 +845,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -749,6 +853,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
 static bool
 setup_stack (void **esp)
 {
+#ifdef VM
+  /* The stack area grows downwards from here on faults. */
+  if (!vmm_setup_stack ())
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
   void *upage;
@@ -757,17 +868,14 @@ setup_stack (void **esp)
   if (kpage != NULL)
     {
       upage = ((uint8_t *)PHYS_BASE) - PGSIZE;
-#ifdef VM
-      success = vmm_create_anonymous (upage, true);
-#else
       success = install_page (upage, kpage, true);
-#endif
       if (success)
         *esp = PHYS_BASE;
       else
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
 #ifndef VM
@@ -43,6 +43,10 @@ static int syscall_close (void *);
 #ifdef VM
 static int syscall_mmap (void *);
 static int syscall_munmap (void *);
+static int syscall_fork (struct intr_frame *);
+static int syscall_msync (void *);
+static int syscall_vmstat (void *);
+static int syscall_rsslimit (void *);
 #endif
 
 void
@@ -69,11 +73,18 @@ syscall_handler (struct intr_frame *f)
 {
   struct thread *cur = thread_current ();
   int syscall_id;
-  int (*syscall_table[15]) (void *)
-      = { syscall_halt,   syscall_exit,   syscall_exec,  syscall_wait,
-          syscall_create, syscall_remove, syscall_open,  syscall_filesize,
-          syscall_read,   syscall_write,  syscall_seek,  syscall_tell,
-          syscall_close,  syscall_mmap,   syscall_munmap };
+  static int (*const syscall_table[]) (void *) = {
+    syscall_halt,   syscall_exit,   syscall_exec,  syscall_wait,
+    syscall_create, syscall_remove, syscall_open,  syscall_filesize,
+    syscall_read,   syscall_write,  syscall_seek,  syscall_tell,
+    syscall_close,
+#ifdef VM
+    [SYS_MMAP] = syscall_mmap,     [SYS_MUNMAP] = syscall_munmap,
+    [SYS_MSYNC] = syscall_msync,   [SYS_VMSTAT] = syscall_vmstat,
+    [SYS_RSSLIMIT] = syscall_rsslimit,
+#endif
+  };
+  const int syscall_cnt = sizeof syscall_table / sizeof *syscall_table;
   void *sp = f->esp;
 
 #ifdef VM
@@ -82,7 +93,19 @@ syscall_handler (struct intr_frame *f)
 
   pop_arg (int, syscall_id, sp);
 
-  f->eax = syscall_table[syscall_id](sp);
+#ifdef VM
+  /* `FORK` needs the registers of the caller, not just its stack. */
+  if (syscall_id == SYS_FORK)
+    f->eax = syscall_fork (f);
+  else
+#endif
+    {
+      /* Calls out of range or not implemented by this kernel. */
+      if (syscall_id < 0 || syscall_id >= syscall_cnt
+          || syscall_table[syscall_id] == NULL)
+        process_trigger_exit (-1);
+      f->eax = syscall_table[syscall_id](sp);
+    }
 
 #ifdef VM
   cur->esp_before_syscall = NULL;
@@ -482,6 +505,7 @@ syscall_mmap (void *sp)
   struct file *file_reopened;
   struct mmap_user_block *block;
   mapid_t id;
+  off_t length;
   bool success;
   struct thread *cur;
 
@@ -496,16 +520,25 @@ syscall_mmap (void *sp)
     return -1;
 
   block = malloc (sizeof (struct mmap_user_block));
+  if (block == NULL)
+    return -1;
   id = vmm_get_free_mapid ();
 
+  /* Only the file itself needs the file system lock.  The region is recorded
+     without touching its pages, which are read in on first access. */
   thread_acquire_fs_lock ();
   file_reopened = file_reopen (fd_ctx->file);
-  mmap_init_user_block (block, id, file_reopened);
-  success = vmm_setup_user_block (block, addr);
+  length = file_reopened != NULL ? file_length (file_reopened) : 0;
   thread_release_fs_lock ();
 
+  mmap_init_user_block (block, id, file_reopened);
+  success = file_reopened != NULL && vmm_setup_user_block (block, addr, length);
+
   if (!success)
     {
+      thread_acquire_fs_lock ();
+      file_close (file_reopened);
+      thread_release_fs_lock ();
       free (block);
       return -1;
     }
@@ -536,3 +569,85 @@ syscall_munmap (void *sp)
 
   return 0;
 }
+
+#ifdef VM
+/* System call handler for `MSYNC`. */
+static int
+syscall_msync (void *sp)
+{
+  mapid_t id;
+  struct mmap_user_block *block;
+
+  pop_arg (mapid_t, id, sp);
+
+  block = vmm_get_mmap_user_block (id);
+  if (block == NULL)
+    process_trigger_exit (-1);
+
+  thread_acquire_fs_lock ();
+  vmm_sync_user_block (block);
+  thread_release_fs_lock ();
+
+  return true;
+}
+
+/* System call handler for `VMSTAT`. */
+static int
+syscall_vmstat (void *sp)
+{
+  struct vmstat *ustat;
+  struct vmstat stat;
+  struct thread *cur;
+
+  pop_arg (struct vmstat *, ustat, sp);
+
+  cur = thread_current ();
+  stat.rss = cur->rss;
+  stat.rss_limit = cur->rss_limit;
+  stat.wss = cur->wss;
+  stat.faults = cur->fault_cnt;
+  stat.swapins = cur->swapin_cnt;
+  if (checked_memcpy_to_user (ustat, &stat, sizeof stat) == NULL)
+    process_trigger_exit (-1);
+
+  return true;
+}
+
+/* System call handler for `RSSLIMIT`. */
+static int
+syscall_rsslimit (void *sp)
+{
+  int page_cnt;
+
+  pop_arg (int, page_cnt, sp);
+
+  if (page_cnt < 0)
+    return false;
+  vmm_set_rss_limit (page_cnt);
+
+  return true;
+}
+
+/* System call handler for `FORK`. */
+static int
+syscall_fork (struct intr_frame *f)
+{
+  tid_t child_pid;
+  struct process_context *child_ctx;
+
+  child_pid = process_fork (f);
+  child_ctx = process_child_ctx_by_pid (child_pid);
+  if (child_ctx == NULL)
+    return TID_ERROR;
+
+  /* The child copies our address space and files before we may touch them
+     again. */
+  sema_down (&child_ctx->load_sema);
+  if (!child_ctx->load_success)
+    {
+      process_cleanup_ctx (child_ctx);
+      return TID_ERROR;
+    }
+  return child_pid;
+}
+#endif
@@ -0,0 +1,579 @@
+#include "vm/evict.h"
+
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+
+#include <debug.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Distance in frames the front hand of the two-handed clock runs ahead of the
+   back hand. */
+#define HANDSPREAD 16
+
+/* Working set window of WSClock in timer ticks.  Frames not referenced for
+   longer than this are considered out of their process's working set. */
+#define WSCLOCK_WINDOW (TIMER_FREQ / 2)
+
+/* Frames that currently own a page from the user pool, in clock order.  Only
+   one policy is active at a time, so all of them share this list. */
+static struct list resident_frames;
+static size_t resident_cnt;
+
+/* Returns the frame `hand` points to. */
+static struct frame *
+hand_frame (struct list_elem *hand)
+{
+  return list_entry (hand, struct frame, global_elem);
+}
+
+/* Returns the element after `el` in the frame list, wrapping around at the
+   end. */
+static struct list_elem *
+next_wrap (struct list_elem *el)
+{
+  el = list_next (el);
+  return el != list_end (&resident_frames) ? el : list_begin (&resident_frames);
+}
+
+/* Add `frame` to the tail of the frame list, pointing `hand` to it if the
+   hand is not set. */
+static void
+push_frame (struct frame *frame, struct list_elem **hand)
+{
+  list_push_back (&resident_frames, &frame->global_elem);
+  resident_cnt++;
+  if (*hand == NULL)
+    *hand = &frame->global_elem;
+}
+
+/* Move `hand` to the next frame if it points to `frame`, which is about to be
+   removed from the frame list. */
+static void
+move_hand_off (struct list_elem **hand, struct frame *frame)
+{
+  if (*hand != &frame->global_elem)
+    return;
+
+  *hand = next_wrap (*hand);
+  if (*hand == &frame->global_elem)
+    *hand = NULL;
+}
+
+/* Remove `frame` from the frame list. */
+static void
+pop_frame (struct frame *frame)
+{
+  list_remove (&frame->global_elem);
+  resident_cnt--;
+}
+
+/* Try to acquire the lock of `frame`.  Fails if the frame is busy, including
+   when the current thread already holds it, e.g. as an earlier victim of the
+   same batch. */
+static bool
+try_pin (struct frame *frame)
+{
+  return !lock_held_by_current_thread (&frame->lock)
+         && lock_try_acquire (&frame->lock);
+}
+
+/* Returns true if any mapping of `frame` was accessed since the accessed bits
+   were last cleared.  Every mapping is inspected through the page directory it
+   is installed in, so frames of other processes are judged by their own page
+   tables.  Bits the working set sampler cleared in the meantime are kept in
+   `referenced`.  The caller must hold the lock of `frame`. */
+static bool
+is_accessed (struct frame *frame)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+
+  if (frame->referenced)
+    return true;
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    {
+      info = list_entry (el, struct mmap_info, elem);
+      if (pagedir_is_accessed (info->pagedir, info->upage))
+        return true;
+    }
+  return false;
+}
+
+/* Like `is_accessed`, but also clears the accessed bits. */
+static bool
+test_and_clear_accessed (struct frame *frame)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+  bool accessed;
+
+  accessed = frame->referenced;
+  frame->referenced = false;
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    {
+      info = list_entry (el, struct mmap_info, elem);
+      if (!pagedir_is_accessed (info->pagedir, info->upage))
+        continue;
+
+      accessed = true;
+      pagedir_set_accessed (info->pagedir, info->upage, false);
+    }
+  return accessed;
+}
+
+/* Returns true if any mapping of `frame` was written to.  The caller must hold
+   the lock of `frame`. */
+static bool
+is_dirty (struct frame *frame)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    {
+      info = list_entry (el, struct mmap_info, elem);
+      if (pagedir_is_dirty (info->pagedir, info->upage))
+        return true;
+    }
+  return false;
+}
+
+/* Second-chance clock with a single hand.  A frame is evicted when the hand
+   finds it unreferenced; referenced frames get their accessed bits cleared. */
+
+static struct list_elem *clock_hand;
+
+static void
+clock_init (void)
+{
+  list_init (&resident_frames);
+  resident_cnt = 0;
+  clock_hand = NULL;
+}
+
+static void
+clock_add (struct frame *frame)
+{
+  push_frame (frame, &clock_hand);
+}
+
+static void
+clock_remove (struct frame *frame)
+{
+  move_hand_off (&clock_hand, frame);
+  pop_frame (frame);
+}
+
+static struct frame *
+clock_select (void)
+{
+  struct frame *frame;
+  size_t budget;
+
+  /* Two sweeps are enough to find an unreferenced frame, since the first one
+     clears every accessed bit it passes.  Busy frames do not count. */
+  budget = 2 * resident_cnt;
+  for (; budget > 0; budget--, clock_hand = next_wrap (clock_hand))
+    {
+      frame = hand_frame (clock_hand);
+      if (!try_pin (frame))
+        continue;
+      if (!test_and_clear_accessed (frame))
+        return frame;
+      lock_release (&frame->lock);
+    }
+  return NULL;
+}
+
+const struct evict_policy evict_clock = {
+  "clock", clock_init, clock_add, clock_remove, clock_select,
+};
+
+/* Two-handed clock.  The front hand clears accessed bits and the back hand,
+   trailing it by `HANDSPREAD` frames, evicts frames that were not referenced
+   since the front hand passed them.  Unlike the one-handed clock, the time a
+   frame has to prove itself does not depend on the amount of memory. */
+
+static struct list_elem *front_hand, *back_hand;
+
+static void
+two_handed_clock_init (void)
+{
+  list_init (&resident_frames);
+  resident_cnt = 0;
+  front_hand = back_hand = NULL;
+}
+
+static void
+two_handed_clock_add (struct frame *frame)
+{
+  push_frame (frame, &front_hand);
+  if (back_hand == NULL)
+    back_hand = front_hand;
+}
+
+static void
+two_handed_clock_remove (struct frame *frame)
+{
+  move_hand_off (&front_hand, frame);
+  move_hand_off (&back_hand, frame);
+  pop_frame (frame);
+}
+
+/* Clear the accessed bits of the frame under the front hand, and advance the
+   front hand. */
+static void
+advance_front_hand (void)
+{
+  struct frame *frame;
+
+  frame = hand_frame (front_hand);
+  if (try_pin (frame))
+    {
+      test_and_clear_accessed (frame);
+      lock_release (&frame->lock);
+    }
+  front_hand = next_wrap (front_hand);
+}
+
+static struct frame *
+two_handed_clock_select (void)
+{
+  struct frame *frame;
+  size_t spread, budget;
+
+  if (resident_cnt == 0)
+    return NULL;
+
+  /* Removals may have made the hands meet.  Restore the spread. */
+  if (front_hand == back_hand)
+    {
+      spread = resident_cnt / 2 < HANDSPREAD ? resident_cnt / 2 : HANDSPREAD;
+      while (spread-- > 0)
+        advance_front_hand ();
+    }
+
+  budget = 2 * resident_cnt + HANDSPREAD;
+  for (; budget > 0; budget--)
+    {
+      frame = hand_frame (back_hand);
+      if (try_pin (frame))
+        {
+          if (!is_accessed (frame))
+            return frame;
+          lock_release (&frame->lock);
+        }
+      advance_front_hand ();
+      back_hand = next_wrap (back_hand);
+    }
+  return NULL;
+}
+
+const struct evict_policy evict_two_handed_clock = {
+  "twohand",
+  two_handed_clock_init,
+  two_handed_clock_add,
+  two_handed_clock_remove,
+  two_handed_clock_select,
+};
+
+/* CLOCK-Pro.  Frames are either hot or cold.  A cold frame starts a test
+   period when it becomes resident, and is promoted to hot if it is referenced
+   again within the test period, even if it was evicted in the meantime.  The
+   cold hand evicts unreferenced cold frames, and the hot hand demotes
+   unreferenced hot frames whenever hot frames exceed their share of memory.
+   The share of cold frames adapts to how often test periods end in reuse.
+
+   Since frame objects outlive their residency, a nonresident frame in its test
+   period is remembered through its own `in_test` flag instead of a separate
+   list of nonresident pages.  Its test period ends once as many evictions have
+   happened since its own as there are resident frames. */
+
+static struct list_elem *hot_hand, *cold_hand;
+static size_t hot_cnt;     /* Number of resident hot frames. */
+static size_t cold_target; /* Desired number of resident cold frames. */
+static unsigned evict_seq; /* Number of evictions so far. */
+
+/* Grow the share of cold frames by one, if there is room. */
+static void
+grow_cold_target (void)
+{
+  if (cold_target + 1 < resident_cnt)
+    cold_target++;
+}
+
+/* Shrink the share of cold frames by one, keeping at least one. */
+static void
+shrink_cold_target (void)
+{
+  if (cold_target > 1)
+    cold_target--;
+}
+
+static void
+clock_pro_init (void)
+{
+  list_init (&resident_frames);
+  resident_cnt = 0;
+  hot_hand = cold_hand = NULL;
+  hot_cnt = 0;
+  cold_target = 1;
+  evict_seq = 0;
+}
+
+static void
+clock_pro_add (struct frame *frame)
+{
+  bool test_pending;
+
+  test_pending = frame->was_victim && frame->in_test;
+  push_frame (frame, &cold_hand);
+  if (hot_hand == NULL)
+    hot_hand = cold_hand;
+
+  if (test_pending && evict_seq - frame->test_stamp <= resident_cnt)
+    {
+      /* Reused within its test period: the cold share was too small. */
+      frame->hot = true;
+      frame->in_test = false;
+      hot_cnt++;
+      grow_cold_target ();
+    }
+  else
+    {
+      if (test_pending)
+        shrink_cold_target ();
+      frame->hot = false;
+      frame->in_test = true;
+    }
+}
+
+static void
+clock_pro_remove (struct frame *frame)
+{
+  if (frame->hot)
+    {
+      frame->hot = false;
+      hot_cnt--;
+    }
+  move_hand_off (&hot_hand, frame);
+  move_hand_off (&cold_hand, frame);
+  pop_frame (frame);
+}
+
+/* Run the hot hand over one frame.  Unreferenced hot frames are demoted, and
+   test periods of cold frames end when the hot hand passes them. */
+static void
+advance_hot_hand (void)
+{
+  struct frame *frame;
+
+  frame = hand_frame (hot_hand);
+  if (try_pin (frame))
+    {
+      if (frame->hot)
+        {
+          if (!test_and_clear_accessed (frame))
+            {
+              frame->hot = false;
+              frame->in_test = false;
+              hot_cnt--;
+            }
+        }
+      else if (frame->in_test && !is_accessed (frame))
+        {
+          frame->in_test = false;
+          shrink_cold_target ();
+        }
+      lock_release (&frame->lock);
+    }
+  hot_hand = next_wrap (hot_hand);
+}
+
+static struct frame *
+clock_pro_select (void)
+{
+  struct frame *frame;
+  size_t budget;
+
+  budget = 3 * resident_cnt;
+  for (; budget > 0; budget--, cold_hand = next_wrap (cold_hand))
+    {
+      if (hot_cnt > 0 && hot_cnt + cold_target > resident_cnt)
+        advance_hot_hand ();
+
+      frame = hand_frame (cold_hand);
+      if (frame->hot || !try_pin (frame))
+        continue;
+
+      if (test_and_clear_accessed (frame))
+        {
+          if (frame->in_test)
+            {
+              frame->hot = true;
+              frame->in_test = false;
+              hot_cnt++;
+              grow_cold_target ();
+            }
+          else
+            frame->in_test = true;
+          lock_release (&frame->lock);
+          continue;
+        }
+
+      /* The victim keeps its test period while it is not resident. */
+      frame->test_stamp = evict_seq++;
+      return frame;
+    }
+  return NULL;
+}
+
+const struct evict_policy evict_clock_pro = {
+  "clockpro", clock_pro_init, clock_pro_add, clock_pro_remove,
+  clock_pro_select,
+};
+
+/* WSClock.  Frames referenced within the last `WSCLOCK_WINDOW` ticks are in
+   their process's working set and are kept.  Outside the working set, clean
+   frames are evicted first, since they are cheaper to drop; dirty frames are
+   only taken on the second lap.  If nothing qualifies, the least recently
+   used frame seen is evicted. */
+
+static struct list_elem *wsclock_hand;
+
+static void
+wsclock_init (void)
+{
+  list_init (&resident_frames);
+  resident_cnt = 0;
+  wsclock_hand = NULL;
+}
+
+static void
+wsclock_add (struct frame *frame)
+{
+  frame->last_used = timer_ticks ();
+  push_frame (frame, &wsclock_hand);
+}
+
+static void
+wsclock_remove (struct frame *frame)
+{
+  move_hand_off (&wsclock_hand, frame);
+  pop_frame (frame);
+}
+
+static struct frame *
+wsclock_select (void)
+{
+  struct frame *frame, *oldest;
+  int64_t now;
+  size_t i, lap;
+
+  now = timer_ticks ();
+  oldest = NULL;
+  lap = resident_cnt;
+  for (i = 0; i < 2 * lap; i++, wsclock_hand = next_wrap (wsclock_hand))
+    {
+      frame = hand_frame (wsclock_hand);
+      if (!try_pin (frame))
+        continue;
+
+      if (test_and_clear_accessed (frame))
+        frame->last_used = now;
+      else if (now - frame->last_used > WSCLOCK_WINDOW
+               && (i >= lap || !is_dirty (frame)))
+        return frame;
+      else if (oldest == NULL || frame->last_used < oldest->last_used)
+        oldest = frame;
+      lock_release (&frame->lock);
+    }
+
+  /* Frames cannot leave the frame list while the frame table lock is held, so
+     `oldest` is still valid. */
+  if (oldest != NULL && try_pin (oldest))
+    return oldest;
+  return NULL;
+}
+
+const struct evict_policy evict_wsclock = {
+  "wsclock", wsclock_init, wsclock_add, wsclock_remove, wsclock_select,
+};
+
+/* Call `func` with `aux` for every resident frame.  The frames are not
+   locked. */
+void
+evict_for_each_frame (void (*func) (struct frame *, void *), void *aux)
+{
+  struct list_elem *el;
+
+  for (el = list_begin (&resident_frames); el != list_end (&resident_frames);
+       el = list_next (el))
+    func (hand_frame (el), aux);
+}
+
+/* Returns true if every mapping of `frame` belongs to `owner`.  The caller
+   must hold the lock of `frame`. */
+static bool
+owned_by (struct frame *frame, const struct thread *owner)
+{
+  struct list_elem *el;
+
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    if (list_entry (el, struct mmap_info, elem)->owner != owner)
+      return false;
+  return true;
+}
+
+/* Choose a victim among the frames that only `owner` maps, giving
+   referenced frames a second chance, regardless of the active policy.  Used
+   to keep a process within its resident set limit at its own expense.  The
+   victim is returned with its lock held.  Returns NULL if there is none. */
+struct frame *
+evict_select_owned (const struct thread *owner)
+{
+  struct list_elem *el;
+  struct frame *frame;
+  int pass;
+
+  for (pass = 0; pass < 2; pass++)
+    for (el = list_begin (&resident_frames); el != list_end (&resident_frames);
+         el = list_next (el))
+      {
+        frame = hand_frame (el);
+        if (!try_pin (frame))
+          continue;
+        if (owned_by (frame, owner) && !frame->prefetched
+            && !test_and_clear_accessed (frame))
+          return frame;
+        lock_release (&frame->lock);
+      }
+  return NULL;
+}
+
+/* Find replacement policy by its name.  Returns NULL if there is no such
+   policy. */
+const struct evict_policy *
+evict_lookup_policy (const char *name)
+{
+  static const struct evict_policy *policies[] = {
+    &evict_clock, &evict_two_handed_clock, &evict_clock_pro, &evict_wsclock,
+  };
+  size_t i;
+
+  for (i = 0; i < sizeof policies / sizeof *policies; i++)
+    if (!strcmp (policies[i]->name, name))
+      return policies[i];
+  return NULL;
+}
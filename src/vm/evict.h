@@ -0,0 +1,36 @@
+#ifndef VM_EVICT_H
+#define VM_EVICT_H
+
+#include "threads/thread.h"
+#include "vm/frame.h"
+
+#include <stdbool.h>
+
+/* Page replacement policy.
+
+   A policy keeps track of every resident frame of every process and chooses
+   which one to evict when the user pool runs dry.  All operations are called
+   by the swap manager with its frame table lock held. */
+struct evict_policy
+{
+  const char *name; /* Name used on the kernel command line. */
+
+  void (*init) (void);             /* Initialize policy state. */
+  void (*add) (struct frame *);    /* `frame` became resident. */
+  void (*remove) (struct frame *); /* `frame` is no longer resident. */
+
+  /* Choose a victim frame.  The victim is returned with its lock held.
+     Returns NULL if every frame is busy. */
+  struct frame *(*select) (void);
+};
+
+extern const struct evict_policy evict_clock;
+extern const struct evict_policy evict_two_handed_clock;
+extern const struct evict_policy evict_clock_pro;
+extern const struct evict_policy evict_wsclock;
+
+const struct evict_policy *evict_lookup_policy (const char *);
+void evict_for_each_frame (void (*) (struct frame *, void *), void *);
+struct frame *evict_select_owned (const struct thread *);
+
+#endif
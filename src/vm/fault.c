@@ -0,0 +1,243 @@
+#include "vm/fault.h"
+
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Page fault latency.
+
+   Every page fault the virtual memory manager services is timed with the
+   time-stamp counter, and charged to the cause that `fault_note` reported
+   for it.  Latencies are counted in histograms with power-of-two buckets,
+   once for the whole system and once for the faulting process.  When a
+   process exits, its histograms are added to those of all earlier processes
+   of the same program, which are printed at shutdown. */
+
+/* Latencies below 2**`FAULT_BUCKET_SHIFT` cycles go to the first bucket,
+   those of 2**(`FAULT_BUCKET_SHIFT` + `FAULT_BUCKET_CNT` - 2) cycles and more
+   to the last one. */
+#define FAULT_BUCKET_SHIFT 10
+#define FAULT_BUCKET_CNT 20
+
+/* Fault latency histograms by cause. */
+struct fault_profile
+{
+  uint32_t bucket[FAULT_CAUSE_CNT][FAULT_BUCKET_CNT]; /* Faults per bucket. */
+  long long cnt[FAULT_CAUSE_CNT];                     /* Faults. */
+  uint64_t cycles[FAULT_CAUSE_CNT];                   /* Total latency. */
+};
+
+/* Profile of the exited processes of a program. */
+struct fault_program
+{
+  char name[16];                /* Name of the program. */
+  struct fault_profile profile; /* Sum of the profiles of its processes. */
+  struct list_elem elem;        /* Element in `programs`. */
+};
+
+static const char *cause_names[FAULT_CAUSE_CNT]
+    = { "minor", "zero-fill", "copy", "stack", "file", "swap-in", "evict" };
+
+static struct fault_profile global_profile; /* Faults of all processes. */
+static struct list programs;                /* List of `fault_program`. */
+static struct lock programs_lock;           /* Protects `programs`. */
+
+/* Returns the time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
+/* Initialize fault profiling. */
+void
+fault_init (void)
+{
+  list_init (&programs);
+  lock_init (&programs_lock);
+}
+
+/* Start profiling the faults of the current process.  Returns false if
+   there is no memory for its profile; its faults are still counted
+   globally. */
+bool
+fault_profile_create (void)
+{
+  struct thread *cur;
+
+  cur = thread_current ();
+  cur->fault_profile = calloc (1, sizeof *cur->fault_profile);
+  return cur->fault_profile != NULL;
+}
+
+/* Add `src` to `dst`. */
+static void
+add_profile (struct fault_profile *dst, const struct fault_profile *src)
+{
+  int cause, i;
+
+  for (cause = 0; cause < FAULT_CAUSE_CNT; cause++)
+    {
+      for (i = 0; i < FAULT_BUCKET_CNT; i++)
+        dst->bucket[cause][i] += src->bucket[cause][i];
+      dst->cnt[cause] += src->cnt[cause];
+      dst->cycles[cause] += src->cycles[cause];
+    }
+}
+
+/* Returns the profile of the exited processes of program `name`, creating it
+   if necessary.  Returns NULL if memory is exhausted.  The caller must hold
+   `programs_lock`. */
+static struct fault_profile *
+program_profile (const char *name)
+{
+  struct fault_program *p;
+  struct list_elem *el;
+
+  for (el = list_begin (&programs); el != list_end (&programs);
+       el = list_next (el))
+    {
+      p = list_entry (el, struct fault_program, elem);
+      if (!strcmp (p->name, name))
+        return &p->profile;
+    }
+
+  p = calloc (1, sizeof *p);
+  if (p == NULL)
+    return NULL;
+  strlcpy (p->name, name, sizeof p->name);
+  list_push_back (&programs, &p->elem);
+  return &p->profile;
+}
+
+/* Stop profiling the faults of the current process, and add its profile to
+   those of its program. */
+void
+fault_profile_destroy (void)
+{
+  struct thread *cur;
+  struct fault_profile *profile;
+
+  cur = thread_current ();
+  if (cur->fault_profile == NULL)
+    return;
+
+  lock_acquire (&programs_lock);
+  profile = program_profile (cur->name);
+  if (profile != NULL)
+    add_profile (profile, cur->fault_profile);
+  lock_release (&programs_lock);
+
+  free (cur->fault_profile);
+  cur->fault_profile = NULL;
+}
+
+/* Start timing a page fault of the current thread.  Returns the time it
+   started, for `fault_end`. */
+uint64_t
+fault_begin (void)
+{
+  thread_current ()->fault_cause = FAULT_MINOR;
+  return rdtsc ();
+}
+
+/* Report that the page fault being serviced takes the path of `cause`. */
+void
+fault_note (enum fault_cause cause)
+{
+  struct thread *cur;
+
+  cur = thread_current ();
+  if (cause > cur->fault_cause)
+    cur->fault_cause = cause;
+}
+
+/* Returns the histogram bucket of `cycles`. */
+static int
+bucket_of (uint64_t cycles)
+{
+  int bucket;
+
+  for (bucket = 0; bucket < FAULT_BUCKET_CNT - 1; bucket++)
+    if (cycles < (uint64_t)1 << (bucket + FAULT_BUCKET_SHIFT))
+      break;
+  return bucket;
+}
+
+/* Count a fault of `cause` that took `cycles` in `profile`. */
+static void
+record (struct fault_profile *profile, enum fault_cause cause,
+        uint64_t cycles)
+{
+  profile->bucket[cause][bucket_of (cycles)]++;
+  profile->cnt[cause]++;
+  profile->cycles[cause] += cycles;
+}
+
+/* Finish timing the page fault that started at `start`, after it was
+   serviced. */
+void
+fault_end (uint64_t start)
+{
+  struct thread *cur;
+  enum intr_level old_level;
+  uint64_t cycles;
+
+  cycles = rdtsc () - start;
+  cur = thread_current ();
+  if (cur->fault_profile != NULL)
+    record (cur->fault_profile, cur->fault_cause, cycles);
+
+  old_level = intr_disable ();
+  record (&global_profile, cur->fault_cause, cycles);
+  intr_set_level (old_level);
+}
+
+/* Print the histograms of `profile` for `who`. */
+static void
+print_profile (const char *who, const struct fault_profile *profile)
+{
+  int cause, i;
+
+  for (cause = 0; cause < FAULT_CAUSE_CNT; cause++)
+    {
+      if (profile->cnt[cause] == 0)
+        continue;
+
+      printf ("Faults: %s %s: %lld, mean %llu cycles;", who,
+              cause_names[cause], profile->cnt[cause],
+              profile->cycles[cause] / profile->cnt[cause]);
+      for (i = 0; i < FAULT_BUCKET_CNT; i++)
+        if (profile->bucket[cause][i] != 0)
+          printf (" %s2^%d:%" PRIu32, i < FAULT_BUCKET_CNT - 1 ? "<" : ">=",
+                  i + FAULT_BUCKET_SHIFT - (i == FAULT_BUCKET_CNT - 1),
+                  profile->bucket[cause][i]);
+      printf ("\n");
+    }
+}
+
+/* Print page fault latency histograms, of all processes and by program. */
+void
+fault_print_stats (void)
+{
+  struct fault_program *p;
+  struct list_elem *el;
+
+  print_profile ("all", &global_profile);
+  for (el = list_begin (&programs); el != list_end (&programs);
+       el = list_next (el))
+    {
+      p = list_entry (el, struct fault_program, elem);
+      print_profile (p->name, &p->profile);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef VM_FAULT_H
+#define VM_FAULT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* What a page fault took to service.  When a fault takes several of these
+   paths, the latest in this order is charged. */
+enum fault_cause
+{
+  FAULT_MINOR,    /* Page was resident, or mapped to the zero page. */
+  FAULT_ZERO,     /* Frame was zero-filled. */
+  FAULT_COPY,     /* Shared frame was copied on write. */
+  FAULT_STACK,    /* Stack grew. */
+  FAULT_FILE,     /* Page was read from its file. */
+  FAULT_SWAP,     /* Page was read from swap. */
+  FAULT_EVICT,    /* A frame had to be evicted first. */
+  FAULT_CAUSE_CNT /* Number of causes. */
+};
+
+struct fault_profile;
+
+void fault_init (void);
+bool fault_profile_create (void);
+void fault_profile_destroy (void);
+
+uint64_t fault_begin (void);
+void fault_note (enum fault_cause);
+void fault_end (uint64_t);
+
+void fault_print_stats (void);
+
+#endif
@@ -1,17 +1,51 @@
 #include "vm/frame.h"
 
 #include "debug.h"
+#include "threads/synch.h"
+#include "vm/slab.h"
 
 #include <list.h>
 #include <stdbool.h>
 
+/* Frame descriptors. */
+static struct slab_cache frame_cache
+    = SLAB_CACHE_INITIALIZER ("frame", struct frame);
+
+/* Allocate a frame descriptor, without initializing it.  Returns NULL if
+   memory is exhausted. */
+struct frame *
+frame_alloc (void)
+{
+  return slab_alloc (&frame_cache);
+}
+
+/* Free `frame`, allocated with `frame_alloc`. */
+void
+frame_free (struct frame *frame)
+{
+  slab_free (&frame_cache, frame);
+}
+
 /* Initialize `frame` as page frame at `paddr`. */
 void
 frame_init (struct frame *frame)
 {
   frame->kpage = NULL;
+  lock_init (&frame->lock);
   frame->is_stub = true;
   frame->is_swapped_out = false;
   list_init (&frame->mappings);
   frame->swap_sector = -1;
+  frame->prefetched = false;
+  frame->referenced = false;
+  frame->in_zswap = false;
+  frame->zswap_data = NULL;
+  frame->zswap_word = 0;
+  frame->text_inode = NULL;
+  frame->text_offset = 0;
+  frame->was_victim = false;
+  frame->hot = false;
+  frame->in_test = false;
+  frame->test_stamp = 0;
+  frame->last_used = 0;
 }
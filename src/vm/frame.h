@@ -2,26 +2,63 @@
 #define VM_FRAME_H
 
 #include "devices/block.h"
+#include "filesys/off_t.h"
+#include "threads/synch.h"
 
 #include <hash.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
-/* Physical frame. */
+/* Physical frame.
+
+   Frames that currently own a page from the user pool are linked into the
+   global frame table kept by the swap manager, regardless of the process they
+   belong to.  Each entry in `mappings` carries the page directory it is
+   installed in, so the accessed and dirty bits of a frame can be inspected
+   without being the owning process.
+
+   A frame may back mappings of several processes, which share it
+   copy-on-write.  It is owned by its mappings, and freed along with the last
+   one.  While a frame is shared, writable mappings are installed read-only,
+   so that the first write to it faults and makes a private copy. */
 struct frame
 {
   void *kpage; /* Address to a page from user pool. */
 
+  struct lock lock; /* Held while the frame is loaded, evicted or freed. */
+
   bool is_stub;        /* Is this frame a stub frame? */
   bool is_swapped_out; /* Is this frame swapped out? */
 
-  struct list mappings;  /* List of mappings. */
-  struct list_elem elem; /* Element for frame table. */
+  struct list mappings; /* List of mappings. */
 
   struct list_elem global_elem; /* Element for global frame list. */
   block_sector_t swap_sector;   /* Sector number of saved space. */
+
+  bool prefetched; /* Read ahead from swap, but not yet mapped? */
+  bool referenced; /* Accessed bits collected by the working set sampler. */
+
+  /* Owned by the compressed swap pool in vm/zswap.c. */
+  bool in_zswap;       /* Is the frame stored in the pool? */
+  void *zswap_data;    /* Compressed contents, NULL if same-filled. */
+  uint32_t zswap_word; /* Word a same-filled page is filled with. */
+
+  /* Owned by the text cache in vm/text.c. */
+  struct inode *text_inode;   /* Executable of a read-only page, or NULL. */
+  off_t text_offset;          /* Offset of the page in the executable. */
+  struct hash_elem text_elem; /* Element for the text cache. */
+
+  /* Owned by the replacement policy in vm/evict.c. */
+  bool was_victim;     /* Was the frame evicted by the replacement policy? */
+  bool hot;            /* CLOCK-Pro: Is the frame hot? */
+  bool in_test;        /* CLOCK-Pro: Is the frame in its test period? */
+  unsigned test_stamp; /* CLOCK-Pro: Eviction sequence number of frame. */
+  int64_t last_used;   /* WSClock: Tick the frame was last seen referenced. */
 };
 
+struct frame *frame_alloc (void);
+void frame_free (struct frame *);
 void frame_init (struct frame *);
 
 #endif
@@ -1,15 +1,33 @@
 #include "vm/mmap.h"
 
 #include "debug.h"
-#include "threads/malloc.h"
 #include "threads/thread.h"
-#include "userprog/pagedir.h"
+#include "vm/slab.h"
 
 #include <hash.h>
 #include <list.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+/* Mapping descriptors. */
+static struct slab_cache mmap_info_cache
+    = SLAB_CACHE_INITIALIZER ("mapping", struct mmap_info);
+
+/* Allocate a mapping descriptor, without initializing it.  Returns NULL if
+   memory is exhausted. */
+struct mmap_info *
+mmap_info_alloc (void)
+{
+  return slab_alloc (&mmap_info_cache);
+}
+
+/* Free `info`, allocated with `mmap_info_alloc`. */
+void
+mmap_info_free (struct mmap_info *info)
+{
+  slab_free (&mmap_info_cache, info);
+}
+
 /* Hash function for `mmap_info`. */
 unsigned
 mmap_info_hash (const struct hash_elem *el, void *aux UNUSED)
@@ -32,19 +50,12 @@ mmap_info_less (const struct hash_elem *a, const struct hash_elem *b,
   return info_a->upage < info_b->upage;
 }
 
-/* Destructor for `mmap_info`. */
+/* Destructor for `mmap_info`.  The mapping must already be detached from its
+   frame. */
 void
 mmap_info_destruct (struct hash_elem *el, void *aux UNUSED)
 {
-  struct mmap_info *info;
-  struct thread *cur;
-
-  cur = thread_current ();
-  info = hash_entry (el, struct mmap_info, map_elem);
-
-  pagedir_clear_page (cur->pagedir, info->upage);
-  list_remove (&info->elem);
-  free (info);
+  mmap_info_free (hash_entry (el, struct mmap_info, map_elem));
 }
 
 /* Initialize `mmap_info` object for anonymous mapping. */
@@ -52,6 +63,8 @@ void
 mmap_init_anonymous (struct mmap_info *info, void *upage, bool writable)
 {
   info->upage = upage;
+  info->pagedir = thread_current ()->pagedir;
+  info->owner = thread_current ();
   info->file = NULL;
   info->writable = writable;
   info->exe_mapping = false;
@@ -66,6 +79,8 @@ mmap_init_file_map (struct mmap_info *info, void *upage, struct file *file,
                     uint32_t size)
 {
   info->upage = upage;
+  info->pagedir = thread_current ()->pagedir;
+  info->owner = thread_current ();
   info->file = file;
   info->writable = writable;
   info->exe_mapping = exe_mapping;
@@ -80,7 +95,7 @@ mmap_init_user_block (struct mmap_user_block *block, mapid_t id,
 {
   block->id = id;
   block->file = file;
-  list_init (&block->chunks);
+  block->vma = NULL;
 }
 
 bool
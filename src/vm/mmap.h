@@ -5,6 +5,7 @@
 #include "filesys/off_t.h"
 #include "user/syscall.h"
 #include "vm/frame.h"
+#include "vm/vma.h"
 
 #include <hash.h>
 #include <list.h>
@@ -14,7 +15,9 @@
 /* Struct describing memory mapped object. */
 struct mmap_info
 {
-  void *upage;       /* User page the file is mapped to. */
+  void *upage;          /* User page the file is mapped to. */
+  uint32_t *pagedir;    /* Page directory `upage` belongs to. */
+  struct thread *owner; /* Process `upage` belongs to. */
   struct file *file; /* Pointer to mapped file. Set to NULL if the mapping is
                         anonymous. */
 
@@ -28,7 +31,8 @@ struct mmap_info
 
   struct hash_elem map_elem; /* Element for mapping table. */
 
-  struct list_elem chunk_elem; /* Element for chunks list. */
+  struct vma *vma;           /* Area the page belongs to. */
+  struct list_elem vma_elem; /* Element for page list of `vma`. */
 };
 
 /* Struct describing whole file mapped to user memory. Intended for collecting
@@ -38,10 +42,13 @@ struct mmap_user_block
   mapid_t id;        /* Map ID of mapping. */
   struct file *file; /* File that is mapped to memory. */
 
-  struct list chunks;    /* List of `mmap_info`s. */
+  struct vma *vma;       /* Area the file is mapped to. */
   struct list_elem elem; /* Element for mmap_blocks list. */
 };
 
+struct mmap_info *mmap_info_alloc (void);
+void mmap_info_free (struct mmap_info *);
+
 hash_hash_func mmap_info_hash;
 hash_less_func mmap_info_less;
 hash_action_func mmap_info_destruct;
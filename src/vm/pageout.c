@@ -0,0 +1,123 @@
+#include "vm/pageout.h"
+
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+#include "vm/vmm.h"
+
+#include <debug.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* The page-out daemon is woken up when the number of free pages in the user
+   pool drops below the low watermark, and evicts frames until it reaches the
+   high watermark again.  Both are fractions of the user pool, with a lower
+   bound for small pools. */
+#define LOW_WATERMARK_DIV 32
+#define HIGH_WATERMARK_DIV 16
+#define LOW_WATERMARK_MIN 2
+#define HIGH_WATERMARK_MIN 4
+
+static size_t low_watermark;
+static size_t high_watermark;
+
+static bool pageout_started;
+static bool pageout_pending;
+static struct semaphore pageout_sema;
+
+/* Statistics. */
+static long long pageout_wakeup_cnt; /* Number of times daemon ran. */
+static long long pageout_evict_cnt;  /* Number of frames evicted by daemon. */
+
+static thread_func pageout_daemon NO_RETURN;
+
+/* Start the page-out daemon.  Does nothing if there is no swap space to page
+   out to. */
+void
+pageout_init (void)
+{
+  size_t pool_size;
+
+  if (!swap_is_present ())
+    return;
+
+  pool_size = palloc_count_pages (PAL_USER);
+  low_watermark = pool_size / LOW_WATERMARK_DIV;
+  if (low_watermark < LOW_WATERMARK_MIN)
+    low_watermark = LOW_WATERMARK_MIN;
+  high_watermark = pool_size / HIGH_WATERMARK_DIV;
+  if (high_watermark < HIGH_WATERMARK_MIN)
+    high_watermark = HIGH_WATERMARK_MIN;
+
+  sema_init (&pageout_sema, 0);
+  pageout_pending = false;
+  pageout_started
+      = thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL)
+        != TID_ERROR;
+}
+
+/* Wake up the page-out daemon if the user pool is running low on free
+   pages. */
+void
+pageout_wake (void)
+{
+  if (!pageout_started || pageout_pending
+      || palloc_count_free (PAL_USER) >= low_watermark)
+    return;
+
+  pageout_pending = true;
+  sema_up (&pageout_sema);
+}
+
+/* Evict frames in the background until the high watermark is reached, so
+   that page faults find free frames without evicting one themselves.  Victims
+   are evicted in batches, so that their swap slots form a cluster written with
+   a single request. */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  struct frame *victims[SWAP_CLUSTER_PAGES];
+  size_t free_cnt, victim_cnt, freed_cnt, i;
+
+  for (;;)
+    {
+      sema_down (&pageout_sema);
+      pageout_wakeup_cnt++;
+
+      while ((free_cnt = palloc_count_free (PAL_USER)) < high_watermark)
+        {
+          for (victim_cnt = 0; victim_cnt < SWAP_CLUSTER_PAGES
+                               && free_cnt + victim_cnt < high_watermark;
+               victim_cnt++)
+            {
+              victims[victim_cnt] = swap_find_victim ();
+              if (victims[victim_cnt] == NULL)
+                break;
+            }
+          if (victim_cnt == 0)
+            break;
+
+          freed_cnt = vmm_deactivate_frames (victims, victim_cnt);
+          for (i = 0; i < victim_cnt; i++)
+            lock_release (&victims[i]->lock);
+          pageout_evict_cnt += freed_cnt;
+
+          /* Swap space is full.  Faults evict for themselves. */
+          if (freed_cnt == 0)
+            break;
+        }
+
+      pageout_pending = false;
+    }
+}
+
+/* Print statistics of the page-out daemon. */
+void
+pageout_print_stats (void)
+{
+  printf ("Pageout: %lld wakeups, %lld frames evicted in background\n",
+          pageout_wakeup_cnt, pageout_evict_cnt);
+}
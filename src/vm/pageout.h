@@ -0,0 +1,8 @@
+#ifndef VM_PAGEOUT_H
+#define VM_PAGEOUT_H
+
+void pageout_init (void);
+void pageout_wake (void);
+void pageout_print_stats (void);
+
+#endif
@@ -0,0 +1,118 @@
+#include "vm/slab.h"
+
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Slab caches for the descriptors of the virtual memory manager.
+
+   Page faults create frame and mapping descriptors, and would otherwise go
+   through `malloc`, whose size classes are shared with the rest of the
+   kernel.  Each cache instead keeps a free list of its own objects, packed
+   into whole pages of the kernel pool.  A free object holds the link to the
+   next one.  Pages are never given back, since the number of descriptors
+   follows the number of user pages, which the user pool bounds.
+
+   The free list is only touched with interrupts off, so that allocation
+   never sleeps on a lock; only taking a new page may. */
+
+/* Free object. */
+struct slab_object
+{
+  struct slab_object *next;
+};
+
+/* Caches that have taken pages, for statistics. */
+static struct slab_cache *caches;
+
+/* Add a page of free objects to `c`.  Returns false if the kernel pool is
+   out of pages. */
+static bool
+grow (struct slab_cache *c)
+{
+  enum intr_level old_level;
+  struct slab_object *obj;
+  uint8_t *page;
+  size_t i;
+
+  ASSERT (c->size <= PGSIZE);
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return false;
+
+  old_level = intr_disable ();
+  for (i = 0; i + c->size <= PGSIZE; i += c->size)
+    {
+      obj = (struct slab_object *)(page + i);
+      obj->next = c->free;
+      c->free = obj;
+    }
+  if (c->page_cnt++ == 0)
+    {
+      c->next = caches;
+      caches = c;
+    }
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Allocate an object from `c`.  Returns NULL if the kernel pool is out of
+   pages. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  enum intr_level old_level;
+  struct slab_object *obj;
+
+  for (;;)
+    {
+      old_level = intr_disable ();
+      obj = c->free;
+      if (obj != NULL)
+        {
+          c->free = obj->next;
+          if (++c->in_use_cnt > c->peak_cnt)
+            c->peak_cnt = c->in_use_cnt;
+        }
+      intr_set_level (old_level);
+
+      if (obj != NULL)
+        return obj;
+      if (!grow (c))
+        return NULL;
+    }
+}
+
+/* Return `p`, allocated from `c`, to it. */
+void
+slab_free (struct slab_cache *c, void *p)
+{
+  enum intr_level old_level;
+  struct slab_object *obj;
+
+  if (p == NULL)
+    return;
+
+  obj = p;
+  old_level = intr_disable ();
+  obj->next = c->free;
+  c->free = obj;
+  c->in_use_cnt--;
+  intr_set_level (old_level);
+}
+
+/* Print statistics of every slab cache in use. */
+void
+slab_print_stats (void)
+{
+  struct slab_cache *c;
+
+  for (c = caches; c != NULL; c = c->next)
+    printf ("Slab: %s cache, %zu objects in use, peak %zu, %zu pages\n",
+            c->name, c->in_use_cnt, c->peak_cnt, c->page_cnt);
+}
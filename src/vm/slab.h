@@ -0,0 +1,35 @@
+#ifndef VM_SLAB_H
+#define VM_SLAB_H
+
+#include <stddef.h>
+
+/* Cache of fixed-size objects, carved from pages of the kernel pool. */
+struct slab_cache
+{
+  const char *name;         /* Name for statistics. */
+  size_t size;              /* Size of an object, at least a pointer. */
+  struct slab_object *free; /* Free objects. */
+  struct slab_cache *next;  /* Next cache that has pages. */
+
+  /* Statistics. */
+  size_t page_cnt;   /* Pages taken from the kernel pool. */
+  size_t in_use_cnt; /* Objects allocated. */
+  size_t peak_cnt;   /* Largest `in_use_cnt` so far. */
+};
+
+/* Initializer for a cache of objects of `TYPE`. */
+#define SLAB_CACHE_INITIALIZER(NAME, TYPE)                                     \
+  {                                                                            \
+    .name = (NAME), .size = SLAB_OBJECT_SIZE (sizeof (TYPE)), .free = NULL,    \
+    .next = NULL                                                               \
+  }
+
+/* Size of a slot for an object of `SIZE` bytes. */
+#define SLAB_OBJECT_SIZE(SIZE)                                                 \
+  (((SIZE) < sizeof (void *) ? sizeof (void *) : (SIZE)) + 7) / 8 * 8
+
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif
@@ -1,12 +1,12 @@
 #include "vm/swap.h"
 
 #include "devices/block.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
-#include "threads/thread.h"
 #include "threads/vaddr.h"
-#include "userprog/pagedir.h"
+#include "vm/evict.h"
 #include "vm/frame.h"
-#include "vm/mmap.h"
+#include "vm/zswap.h"
 
 #include <bitmap.h>
 #include <debug.h>
@@ -14,165 +14,397 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
 
+/* A lock that counts how often it had to be waited for. */
+struct swap_lock
+{
+  const char *name;        /* Name for statistics. */
+  struct lock lock;        /* The lock itself. */
+  long long acquire_cnt;   /* Number of acquisitions. */
+  long long contended_cnt; /* Number of acquisitions that had to wait. */
+};
+
+/* The swap manager is split under three locks, so that a process waiting for
+   swap I/O does not keep others from registering frames or allocating slots.
+   None of them is held while another one is acquired. */
+static struct swap_lock frame_table_lock; /* Replacement policy. */
+static struct swap_lock slot_lock;        /* `swap_slot_map`. */
+static struct swap_lock io_lock;          /* `cluster_buf`. */
+
 static bool swap_present;
-static struct lock swap_lock;
-static struct list active_frames;
 static struct block *swap_block_dev;
-static struct bitmap *swap_block_map;
-static struct list_elem *clock_hand;
+static struct bitmap *swap_slot_map; /* Page-sized slots in use. */
+static uint8_t *cluster_buf;         /* Staging area for cluster writes. */
+
+/* Page replacement policy, chosen with the "-evict" kernel option. */
+static const struct evict_policy *policy = &evict_clock;
+
+/* Statistics. */
+static long long evict_cnt;   /* Number of frames evicted by the policy. */
+static long long refault_cnt; /* Number of evicted frames faulted back in. */
+static long long clean_cnt;   /* Frames evicted to the slot they kept. */
+static long long full_cnt;    /* Frames not written for lack of slots. */
+
+/* Initialize `l` named `name`. */
+static void
+swap_lock_init (struct swap_lock *l, const char *name)
+{
+  l->name = name;
+  lock_init (&l->lock);
+  l->acquire_cnt = 0;
+  l->contended_cnt = 0;
+}
+
+/* Acquire `l`, counting whether another thread held it. */
+static void
+swap_lock_acquire (struct swap_lock *l)
+{
+  if (!lock_try_acquire (&l->lock))
+    {
+      l->contended_cnt++;
+      lock_acquire (&l->lock);
+    }
+  l->acquire_cnt++;
+}
+
+/* Release `l`. */
+static void
+swap_lock_release (struct swap_lock *l)
+{
+  lock_release (&l->lock);
+}
+
+/* Select page replacement policy by `name`.  May be called before
+   `swap_init`.  Returns false if there is no such policy. */
+bool
+swap_select_policy (const char *name)
+{
+  const struct evict_policy *p;
+
+  p = evict_lookup_policy (name);
+  if (p == NULL)
+    return false;
+  policy = p;
+  return true;
+}
 
 /* Initialize swap manager. */
 void
 swap_init (void)
 {
-  block_sector_t swap_size;
+  size_t slot_cnt;
 
-  lock_init (&swap_lock);
-  list_init (&active_frames);
-  clock_hand = NULL;
+  swap_lock_init (&frame_table_lock, "frame table");
+  swap_lock_init (&slot_lock, "slot");
+  swap_lock_init (&io_lock, "io");
+  policy->init ();
   swap_present = false;
 
   swap_block_dev = block_get_role (BLOCK_SWAP);
   if (swap_block_dev == NULL)
     return;
   swap_present = true;
+  zswap_init ();
 
-  swap_size = block_size (swap_block_dev);
-  swap_block_map = bitmap_create (swap_size);
+  slot_cnt = block_size (swap_block_dev) / SECTORS_PER_PAGE;
+  swap_slot_map = bitmap_create (slot_cnt);
+  cluster_buf = palloc_get_multiple (0, SWAP_CLUSTER_PAGES);
+}
+
+/* Returns true if there is a swap device to evict frames to. */
+bool
+swap_is_present (void)
+{
+  return swap_present;
 }
 
 /* Register frame to swap manager. */
 void
 swap_register_frame (struct frame *frame)
 {
-  lock_acquire (&swap_lock);
+  swap_lock_acquire (&frame_table_lock);
 
-  list_push_back (&active_frames, &frame->global_elem);
-  if (clock_hand == NULL)
-    clock_hand = &frame->global_elem;
+  policy->add (frame);
+  if (frame->was_victim)
+    {
+      refault_cnt++;
+      frame->was_victim = false;
+    }
 
-  lock_release (&swap_lock);
+  swap_lock_release (&frame_table_lock);
 }
 
 /* Unregister frame from swap manager. */
 void
 swap_unregister_frame (struct frame *frame)
 {
-  lock_acquire (&swap_lock);
+  swap_lock_acquire (&frame_table_lock);
+  policy->remove (frame);
+  swap_lock_release (&frame_table_lock);
+}
 
-  if (clock_hand == &frame->global_elem)
+/* Find victim frame among the frames of all processes, using the selected
+   replacement policy.  The victim is returned with its lock held, so that its
+   owner cannot free it or fault it back in while it is being evicted.
+   Returns NULL if no frame could be chosen. */
+struct frame *
+swap_find_victim (void)
+{
+  struct frame *frame;
+
+  ASSERT (swap_present);
+
+  swap_lock_acquire (&frame_table_lock);
+
+  frame = policy->select ();
+  if (frame != NULL)
     {
-      clock_hand = list_next (clock_hand);
-      if (clock_hand == list_end (&active_frames))
-        clock_hand = NULL;
+      frame->was_victim = true;
+      evict_cnt++;
     }
-  list_remove (&frame->global_elem);
 
-  lock_release (&swap_lock);
+  swap_lock_release (&frame_table_lock);
+  return frame;
 }
 
-static bool
-check_and_clear_accessed_bit (struct frame *frame)
+/* Find a victim frame among the frames that only `owner` maps, for a process
+   over its resident set limit.  Like `swap_find_victim`, the victim is
+   returned with its lock held.  Returns NULL if no frame could be chosen. */
+struct frame *
+swap_find_victim_of (const struct thread *owner)
 {
-  struct thread *cur;
-  struct list_elem *el;
-  struct mmap_info *info;
-  bool accessed;
+  struct frame *frame;
 
-  cur = thread_current ();
-  accessed = false;
-  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
-       el = list_next (el))
-    {
-      info = list_entry (el, struct mmap_info, elem);
-      if (!pagedir_is_accessed (cur->pagedir, info->upage))
-        continue;
+  ASSERT (swap_present);
+
+  swap_lock_acquire (&frame_table_lock);
 
-      accessed = true;
-      pagedir_set_accessed (cur->pagedir, info->upage, false);
+  frame = evict_select_owned (owner);
+  if (frame != NULL)
+    {
+      frame->was_victim = true;
+      evict_cnt++;
     }
-  return accessed;
+
+  swap_lock_release (&frame_table_lock);
+  return frame;
 }
 
-/* Find victim frame. */
-struct frame *
-swap_find_victim (void)
+/* Call `func` with `aux` for every resident frame of every process.  No
+   frame becomes or stops being resident meanwhile, but `func` must lock a
+   frame before looking at its mappings, and must not wait for the lock. */
+void
+swap_for_each_frame (void (*func) (struct frame *, void *), void *aux)
+{
+  swap_lock_acquire (&frame_table_lock);
+  evict_for_each_frame (func, aux);
+  swap_lock_release (&frame_table_lock);
+}
+
+/* Allocate `cnt` consecutive swap slots.  Returns the first one, or
+   BITMAP_ERROR if there is no such run of free slots. */
+static size_t
+alloc_slots (size_t cnt)
+{
+  size_t slot;
+
+  swap_lock_acquire (&slot_lock);
+  slot = bitmap_scan_and_flip (swap_slot_map, 0, cnt, false);
+  swap_lock_release (&slot_lock);
+  return slot;
+}
+
+/* Returns true if `frame` owns a slot on the swap device.  A resident frame
+   keeps the slot it was read from for as long as it stays clean. */
+bool
+swap_has_slot (const struct frame *frame)
 {
+  return frame->swap_sector != (block_sector_t)-1;
+}
+
+/* Write `cnt` frames to swap space, at most `SWAP_CLUSTER_PAGES`.  A frame
+   that still owns the slot it was read from is not written again.  Frames
+   that the compressed pool takes stay in memory.  Slots for the others are
+   allocated as one contiguous cluster when possible, so that all of them are
+   written with a single request.  Returns false if some frames could not be
+   stored because swap space is full; those are left without a slot. */
+bool
+swap_write_frames (struct frame **frames_, size_t cnt_)
+{
+  struct frame *frames[SWAP_CLUSTER_PAGES];
+  size_t slot, cnt, i;
+  bool success;
+
   ASSERT (swap_present);
+  ASSERT (cnt_ <= SWAP_CLUSTER_PAGES);
 
-  lock_acquire (&swap_lock);
+  cnt = 0;
+  for (i = 0; i < cnt_; i++)
+    if (swap_has_slot (frames_[i]))
+      clean_cnt++;
+    else if (!zswap_store (frames_[i]))
+      frames[cnt++] = frames_[i];
 
-  if (list_empty (&active_frames))
-    return NULL;
+  if (cnt == 0)
+    return true;
 
-  while (check_and_clear_accessed_bit (
-      list_entry (clock_hand, struct frame, global_elem)))
+  slot = BITMAP_ERROR;
+  if (cnt == 1 || cluster_buf != NULL)
+    slot = alloc_slots (cnt);
+
+  success = true;
+  if (slot != BITMAP_ERROR)
     {
-      clock_hand = list_next (clock_hand);
-      if (clock_hand == list_end (&active_frames))
-        clock_hand = list_begin (&active_frames);
+      for (i = 0; i < cnt; i++)
+        frames[i]->swap_sector = (slot + i) * SECTORS_PER_PAGE;
+      if (cnt == 1)
+        block_write_multiple (swap_block_dev, frames[0]->swap_sector,
+                              SECTORS_PER_PAGE, frames[0]->kpage);
+      else
+        {
+          swap_lock_acquire (&io_lock);
+          for (i = 0; i < cnt; i++)
+            memcpy (cluster_buf + i * PGSIZE, frames[i]->kpage, PGSIZE);
+          block_write_multiple (swap_block_dev, frames[0]->swap_sector,
+                                cnt * SECTORS_PER_PAGE, cluster_buf);
+          swap_lock_release (&io_lock);
+        }
     }
-
-  lock_release (&swap_lock);
-
-  return list_entry (clock_hand, struct frame, global_elem);
+  else
+    {
+      /* Swap space is too fragmented for a cluster.  Write the frames one by
+         one, as long as there are slots left. */
+      for (i = 0; i < cnt; i++)
+        {
+          slot = alloc_slots (1);
+          if (slot == BITMAP_ERROR)
+            {
+              full_cnt++;
+              success = false;
+              continue;
+            }
+          frames[i]->swap_sector = slot * SECTORS_PER_PAGE;
+          block_write_multiple (swap_block_dev, frames[i]->swap_sector,
+                                SECTORS_PER_PAGE, frames[i]->kpage);
+        }
+    }
+  return success;
 }
 
-/* Write frame to swap space. */
-void
+/* Write frame to swap space.  Returns false if swap space is full. */
+bool
 swap_write_frame (struct frame *frame)
 {
-  size_t sector;
-  int i;
+  return swap_write_frames (&frame, 1);
+}
 
+/* Read frame from swap space.  The slot belongs to `frame`, whose lock the
+   caller holds, so no swap lock is needed.  The frame keeps its slot until it
+   is written to or freed. */
+void
+swap_read_frame (struct frame *frame)
+{
   ASSERT (swap_present);
 
-  lock_acquire (&swap_lock);
-
-  sector = bitmap_scan_and_flip (swap_block_map, 0, SECTORS_PER_PAGE, false);
-  ASSERT (sector != BITMAP_ERROR);
-  frame->swap_sector = sector;
+  if (frame->in_zswap)
+    {
+      zswap_load (frame);
+      return;
+    }
 
-  for (i = 0; i < SECTORS_PER_PAGE; i++)
-    block_write (swap_block_dev, sector + i,
-                 (uint8_t *)frame->kpage + i * BLOCK_SECTOR_SIZE);
+  ASSERT (bitmap_test (swap_slot_map, frame->swap_sector / SECTORS_PER_PAGE));
 
-  lock_release (&swap_lock);
+  block_read_multiple (swap_block_dev, frame->swap_sector, SECTORS_PER_PAGE,
+                       frame->kpage);
 }
 
-/* Read frame from swap space. */
+/* Read `cnt` frames, at most `SWAP_CLUSTER_PAGES`, from consecutive swap slots
+   with a single request.  Each frame must already have a page to read into. */
 void
-swap_read_frame (struct frame *frame)
+swap_read_frames (struct frame **frames, size_t cnt)
 {
-  int i;
+  size_t i;
 
   ASSERT (swap_present);
+  ASSERT (cnt <= SWAP_CLUSTER_PAGES);
 
-  lock_acquire (&swap_lock);
+  if (cnt == 0)
+    return;
+  if (cnt == 1 || cluster_buf == NULL)
+    {
+      for (i = 0; i < cnt; i++)
+        swap_read_frame (frames[i]);
+      return;
+    }
 
-  ASSERT (
-      bitmap_count (swap_block_map, frame->swap_sector, SECTORS_PER_PAGE, true)
-      == SECTORS_PER_PAGE);
-  for (i = 0; i < SECTORS_PER_PAGE; i++)
-    block_read (swap_block_dev, frame->swap_sector + i,
-                (uint8_t *)frame->kpage + i * BLOCK_SECTOR_SIZE);
+  for (i = 1; i < cnt; i++)
+    ASSERT (swap_slots_adjacent (frames[i - 1], frames[i]));
 
-  lock_release (&swap_lock);
+  swap_lock_acquire (&io_lock);
+  block_read_multiple (swap_block_dev, frames[0]->swap_sector,
+                       cnt * SECTORS_PER_PAGE, cluster_buf);
+  for (i = 0; i < cnt; i++)
+    memcpy (frames[i]->kpage, cluster_buf + i * PGSIZE, PGSIZE);
+  swap_lock_release (&io_lock);
 }
 
-/* Free frame from swap space. */
+/* Returns true if both frames are swapped out to the swap device, and the
+   swap slot of `b` directly follows the one of `a`. */
+bool
+swap_slots_adjacent (const struct frame *a, const struct frame *b)
+{
+  return a->is_swapped_out && b->is_swapped_out && !a->in_zswap
+         && !b->in_zswap
+         && b->swap_sector == a->swap_sector + SECTORS_PER_PAGE;
+}
+
+/* Free frame from swap space, if it is stored there. */
 void
 swap_free_frame (struct frame *frame)
 {
-  lock_acquire (&swap_lock);
-
-  if (swap_present)
-    bitmap_set_multiple (swap_block_map, frame->swap_sector, SECTORS_PER_PAGE,
-                         false);
+  if (frame->in_zswap)
+    zswap_free (frame);
+  else if (swap_has_slot (frame))
+    {
+      swap_lock_acquire (&slot_lock);
+      bitmap_reset (swap_slot_map, frame->swap_sector / SECTORS_PER_PAGE);
+      swap_lock_release (&slot_lock);
+    }
   frame->swap_sector = -1;
+}
+
+/* Print contention statistics of `l`. */
+static void
+print_lock_stats (const struct swap_lock *l)
+{
+  printf ("Swap: %s lock acquired %lld times, %lld contended\n", l->name,
+          l->acquire_cnt, l->contended_cnt);
+}
+
+/* Print statistics of the swap manager. */
+void
+swap_print_stats (void)
+{
+  size_t slot_cnt, used_cnt;
 
-  lock_release (&swap_lock);
+  printf ("Swap: %s policy, %lld evictions, %lld refaults (%lld%%)\n",
+          policy->name, evict_cnt, refault_cnt,
+          evict_cnt > 0 ? refault_cnt * 100 / evict_cnt : 0);
+  if (swap_present)
+    {
+      slot_cnt = bitmap_size (swap_slot_map);
+      used_cnt = bitmap_count (swap_slot_map, 0, slot_cnt, true);
+      printf ("Swap: %zu of %zu slots used, %zu free\n", used_cnt, slot_cnt,
+              slot_cnt - used_cnt);
+    }
+  printf ("Swap: %lld clean frames evicted without a write, "
+          "%lld not evicted for lack of space\n",
+          clean_cnt, full_cnt);
+  print_lock_stats (&frame_table_lock);
+  print_lock_stats (&slot_lock);
+  print_lock_stats (&io_lock);
 }
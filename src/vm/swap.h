@@ -1,16 +1,33 @@
 #ifndef VM_SWAP_H
 #define VM_SWAP_H
 
+#include "threads/thread.h"
 #include "vm/frame.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Maximum number of frames written to swap space with a single request. */
+#define SWAP_CLUSTER_PAGES 8
+
+bool swap_select_policy (const char *);
 void swap_init (void);
+bool swap_is_present (void);
 
 void swap_register_frame (struct frame *);
 void swap_unregister_frame (struct frame *);
 
 struct frame *swap_find_victim (void);
-void swap_write_frame (struct frame *);
+struct frame *swap_find_victim_of (const struct thread *);
+void swap_for_each_frame (void (*) (struct frame *, void *), void *);
+bool swap_has_slot (const struct frame *);
+bool swap_write_frame (struct frame *);
+bool swap_write_frames (struct frame **, size_t);
 void swap_read_frame (struct frame *);
+void swap_read_frames (struct frame **, size_t);
+bool swap_slots_adjacent (const struct frame *, const struct frame *);
 void swap_free_frame (struct frame *);
 
+void swap_print_stats (void);
+
 #endif
@@ -0,0 +1,127 @@
+#include "vm/text.h"
+
+#include "threads/synch.h"
+#include "vm/frame.h"
+
+#include <debug.h>
+#include <hash.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Text cache.
+
+   Frames of read-only executable pages are kept here keyed by the inode and
+   offset they were loaded from, so that every process running the same
+   program maps the same frames.  A frame stays in the cache while it has
+   mappings.  Every mapping holds the executable open, so the inode of an
+   entry cannot be freed and reused for another file in the meantime.
+
+   `text_lock` must be acquired before the lock of any frame. */
+static struct hash text_frames;
+static struct lock text_lock;
+
+/* Statistics. */
+static long long hit_cnt;  /* Number of pages found in the cache. */
+static long long miss_cnt; /* Number of pages not found. */
+
+/* Hash function for frames in the text cache. */
+static unsigned
+text_hash (const struct hash_elem *el, void *aux UNUSED)
+{
+  const struct frame *frame;
+
+  frame = hash_entry (el, struct frame, text_elem);
+  return hash_bytes (&frame->text_inode, sizeof (frame->text_inode))
+         ^ hash_int (frame->text_offset);
+}
+
+/* Less function for frames in the text cache. */
+static bool
+text_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct frame *frame_a, *frame_b;
+
+  frame_a = hash_entry (a, struct frame, text_elem);
+  frame_b = hash_entry (b, struct frame, text_elem);
+  if (frame_a->text_inode != frame_b->text_inode)
+    return frame_a->text_inode < frame_b->text_inode;
+  return frame_a->text_offset < frame_b->text_offset;
+}
+
+/* Initialize text cache. */
+void
+text_init (void)
+{
+  lock_init (&text_lock);
+  if (!hash_init (&text_frames, text_hash, text_less, NULL))
+    PANIC ("text cache initialization failed");
+}
+
+/* Lock the text cache. */
+void
+text_acquire (void)
+{
+  lock_acquire (&text_lock);
+}
+
+/* Unlock the text cache. */
+void
+text_release (void)
+{
+  lock_release (&text_lock);
+}
+
+/* Find the frame holding the page at `offset` of `inode`.  Returns NULL if
+   there is none.  The caller must hold the text cache lock. */
+struct frame *
+text_lookup (struct inode *inode, off_t offset)
+{
+  struct frame key;
+  struct hash_elem *el;
+
+  ASSERT (lock_held_by_current_thread (&text_lock));
+
+  key.text_inode = inode;
+  key.text_offset = offset;
+  el = hash_find (&text_frames, &key.text_elem);
+  if (el == NULL)
+    {
+      miss_cnt++;
+      return NULL;
+    }
+  hit_cnt++;
+  return hash_entry (el, struct frame, text_elem);
+}
+
+/* Add `frame`, which holds the page at `offset` of `inode`, to the text
+   cache.  The caller must hold the text cache lock. */
+void
+text_insert (struct frame *frame, struct inode *inode, off_t offset)
+{
+  ASSERT (lock_held_by_current_thread (&text_lock));
+  ASSERT (frame->text_inode == NULL);
+
+  frame->text_inode = inode;
+  frame->text_offset = offset;
+  hash_insert (&text_frames, &frame->text_elem);
+}
+
+/* Remove `frame` from the text cache.  The caller must hold the text cache
+   lock. */
+void
+text_remove (struct frame *frame)
+{
+  ASSERT (lock_held_by_current_thread (&text_lock));
+  ASSERT (frame->text_inode != NULL);
+
+  hash_delete (&text_frames, &frame->text_elem);
+  frame->text_inode = NULL;
+}
+
+/* Print statistics of the text cache. */
+void
+text_print_stats (void)
+{
+  printf ("Text: %lld pages shared, %lld pages loaded\n", hit_cnt, miss_cnt);
+}
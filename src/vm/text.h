@@ -0,0 +1,16 @@
+#ifndef VM_TEXT_H
+#define VM_TEXT_H
+
+#include "filesys/inode.h"
+#include "filesys/off_t.h"
+#include "vm/frame.h"
+
+void text_init (void);
+void text_acquire (void);
+void text_release (void);
+struct frame *text_lookup (struct inode *, off_t);
+void text_insert (struct frame *, struct inode *, off_t);
+void text_remove (struct frame *);
+void text_print_stats (void);
+
+#endif
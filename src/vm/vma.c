@@ -0,0 +1,234 @@
+#include "vm/vma.h"
+
+#include <debug.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Initialize `vma` covering pages from `start` up to `end`.  The first
+   `file_size` bytes are backed by `file` from `offset` on. */
+void
+vma_init (struct vma *vma, void *start, void *end, struct file *file,
+          off_t offset, uint32_t file_size, bool writable, bool exe_mapping)
+{
+  vma->start = start;
+  vma->end = end;
+  vma->file = file;
+  vma->offset = offset;
+  vma->file_size = file_size;
+  vma->writable = writable;
+  vma->exe_mapping = exe_mapping;
+  vma->grows_down = false;
+  list_init (&vma->pages);
+  list_init (&vma->large_pages);
+  vma->left = vma->right = NULL;
+  vma->height = 1;
+}
+
+/* Initialize empty `tree`. */
+void
+vma_tree_init (struct vma_tree *tree)
+{
+  tree->root = NULL;
+}
+
+/* Returns the height of the subtree at `node`. */
+static int
+height (const struct vma *node)
+{
+  return node != NULL ? node->height : 0;
+}
+
+/* Recompute the height of `node` from its children. */
+static void
+update_height (struct vma *node)
+{
+  int l = height (node->left), r = height (node->right);
+
+  node->height = (l > r ? l : r) + 1;
+}
+
+/* Rotate the subtree at `node` to the right, and return its new root. */
+static struct vma *
+rotate_right (struct vma *node)
+{
+  struct vma *root = node->left;
+
+  node->left = root->right;
+  root->right = node;
+  update_height (node);
+  update_height (root);
+  return root;
+}
+
+/* Rotate the subtree at `node` to the left, and return its new root. */
+static struct vma *
+rotate_left (struct vma *node)
+{
+  struct vma *root = node->right;
+
+  node->right = root->left;
+  root->left = node;
+  update_height (node);
+  update_height (root);
+  return root;
+}
+
+/* Restore the balance of the subtree at `node`, whose children are
+   balanced, and return its new root. */
+static struct vma *
+rebalance (struct vma *node)
+{
+  int balance;
+
+  update_height (node);
+  balance = height (node->left) - height (node->right);
+  if (balance > 1)
+    {
+      if (height (node->left->left) < height (node->left->right))
+        node->left = rotate_left (node->left);
+      return rotate_right (node);
+    }
+  if (balance < -1)
+    {
+      if (height (node->right->right) < height (node->right->left))
+        node->right = rotate_right (node->right);
+      return rotate_left (node);
+    }
+  return node;
+}
+
+/* Insert `vma` into the subtree at `node`, and return its new root. */
+static struct vma *
+insert (struct vma *node, struct vma *vma)
+{
+  if (node == NULL)
+    return vma;
+  if (vma->start < node->start)
+    node->left = insert (node->left, vma);
+  else
+    node->right = insert (node->right, vma);
+  return rebalance (node);
+}
+
+/* Remove the lowest area of the subtree at `node` and store it into `min`.
+   Returns the new root of the subtree. */
+static struct vma *
+remove_min (struct vma *node, struct vma **min)
+{
+  if (node->left == NULL)
+    {
+      *min = node;
+      return node->right;
+    }
+  node->left = remove_min (node->left, min);
+  return rebalance (node);
+}
+
+/* Remove `vma` from the subtree at `node`, and return its new root. */
+static struct vma *
+remove (struct vma *node, struct vma *vma)
+{
+  struct vma *min;
+
+  ASSERT (node != NULL);
+
+  if (vma->start < node->start)
+    node->left = remove (node->left, vma);
+  else if (vma->start > node->start)
+    node->right = remove (node->right, vma);
+  else
+    {
+      ASSERT (node == vma);
+      if (node->right == NULL)
+        return node->left;
+      node->right = remove_min (node->right, &min);
+      min->left = node->left;
+      min->right = node->right;
+      return rebalance (min);
+    }
+  return rebalance (node);
+}
+
+/* Insert `vma` into `tree`.  Returns false if it overlaps an area already in
+   `tree`. */
+bool
+vma_insert (struct vma_tree *tree, struct vma *vma)
+{
+  ASSERT (vma->start < vma->end);
+
+  if (vma_find_overlap (tree, vma->start, vma->end) != NULL)
+    return false;
+  vma->left = vma->right = NULL;
+  vma->height = 1;
+  tree->root = insert (tree->root, vma);
+  return true;
+}
+
+/* Remove `vma` from `tree`. */
+void
+vma_remove (struct vma_tree *tree, struct vma *vma)
+{
+  tree->root = remove (tree->root, vma);
+}
+
+/* Find the area of `tree` that contains `addr`.  Returns NULL if there is
+   none. */
+struct vma *
+vma_find (const struct vma_tree *tree, const void *addr)
+{
+  return vma_find_overlap (tree, addr, (const uint8_t *)addr + 1);
+}
+
+/* Find an area of `tree` that overlaps the range from `start` up to `end`.
+   Returns NULL if there is none. */
+struct vma *
+vma_find_overlap (const struct vma_tree *tree, const void *start,
+                  const void *end)
+{
+  struct vma *node;
+
+  node = tree->root;
+  while (node != NULL)
+    {
+      if (end <= node->start)
+        node = node->left;
+      else if (start >= node->end)
+        node = node->right;
+      else
+        return node;
+    }
+  return NULL;
+}
+
+/* Returns the lowest area of `tree`, or NULL if `tree` is empty. */
+struct vma *
+vma_first (const struct vma_tree *tree)
+{
+  struct vma *node;
+
+  node = tree->root;
+  if (node != NULL)
+    while (node->left != NULL)
+      node = node->left;
+  return node;
+}
+
+/* Returns the area of `tree` following `vma`, or NULL if there is none. */
+struct vma *
+vma_next (const struct vma_tree *tree, const struct vma *vma)
+{
+  struct vma *node, *next;
+
+  next = NULL;
+  node = tree->root;
+  while (node != NULL)
+    if (node->start > vma->start)
+      {
+        next = node;
+        node = node->left;
+      }
+    else
+      node = node->right;
+  return next;
+}
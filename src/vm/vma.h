@@ -0,0 +1,58 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+
+#include "filesys/file.h"
+#include "filesys/off_t.h"
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Virtual memory area.
+
+   A contiguous range of user pages with common backing: a file, followed by
+   zeros, or only zeros for an anonymous area.  Per-page state, an
+   `mmap_info` and its frame, is only created when a page is first touched,
+   and kept in `pages`. */
+struct vma
+{
+  void *start;        /* First page of the area. */
+  void *end;          /* Page after the last page of the area. */
+  struct file *file;  /* Backing file, or NULL if the area is anonymous. */
+  off_t offset;       /* Offset of `start` in `file`. */
+  uint32_t file_size; /* Bytes backed by `file`.  The rest are zeros. */
+  bool writable;      /* Whether the area is writable. */
+  bool exe_mapping;   /* Whether the area is part of the executable. */
+  bool grows_down;    /* Whether the area is a stack.  The page below it is
+                         a guard page that no other area may cover. */
+
+  struct list pages; /* List of `mmap_info`s created so far. */
+  struct list_elem writeback_elem; /* Element in vm/writeback.c. */
+  struct list large_pages;         /* Large pages, owned by vm/vmm.c. */
+
+  /* Owned by vm/vma.c. */
+  struct vma *left;  /* Areas below this one. */
+  struct vma *right; /* Areas above this one. */
+  int height;        /* Height of the subtree. */
+};
+
+/* Set of non-overlapping areas of an address space, as an AVL tree ordered
+   by address. */
+struct vma_tree
+{
+  struct vma *root;
+};
+
+void vma_init (struct vma *, void *, void *, struct file *, off_t, uint32_t,
+               bool, bool);
+
+void vma_tree_init (struct vma_tree *);
+bool vma_insert (struct vma_tree *, struct vma *);
+void vma_remove (struct vma_tree *, struct vma *);
+struct vma *vma_find (const struct vma_tree *, const void *);
+struct vma *vma_find_overlap (const struct vma_tree *, const void *,
+                              const void *);
+struct vma *vma_first (const struct vma_tree *);
+struct vma *vma_next (const struct vma_tree *, const struct vma *);
+
+#endif
@@ -1,26 +1,101 @@
 #include "vm/vmm.h"
 
+#include "devices/timer.h"
 #include "filesys/file.h"
 #include "stddef.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "user/syscall.h"
 #include "userprog/pagedir.h"
+#include "vm/fault.h"
 #include "vm/frame.h"
 #include "vm/mmap.h"
+#include "vm/pageout.h"
+#include "vm/slab.h"
 #include "vm/swap.h"
+#include "vm/text.h"
+#include "vm/writeback.h"
 
 #include <hash.h>
 #include <list.h>
+#include <round.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #define STACK_GROW_LIMIT 32
 #define STACK_MAXSIZE (8 << 20)
 
+/* The stack grows by twice as many pages as the last time if that was less
+   than `STACK_BURST_TICKS` ago, by at most `STACK_GROW_MAX_PAGES`. */
+#define STACK_BURST_TICKS (TIMER_FREQ / 10)
+#define STACK_GROW_MAX_PAGES 16
+
+/* Number of following pages read ahead on a swap-in, set with the
+   "-readahead" kernel option. */
+static size_t readahead_window = 4;
+
+/* Number of pages reserved for the stack of a new process and brought in
+   before it starts, set with the "-stack" kernel option. */
+static size_t stack_initial_pages = 4;
+
+/* Resident set limit of new processes in pages, set with the "-rsslimit"
+   kernel option.  Zero means no limit. */
+static size_t default_rss_limit;
+
+/* Number of pages, around a fault on executable code, that are mapped along
+   with the faulting page, set with the "-faultaround" kernel option. */
+static size_t fault_around_window = 16;
+
+/* Statistics. */
+static long long readahead_cnt;      /* Number of pages read ahead. */
+static long long readahead_hit_cnt;  /* Read-ahead pages used later. */
+static long long readahead_miss_cnt; /* Read-ahead pages evicted unused. */
+static long long share_cnt;          /* Pages shared with another process. */
+static long long copy_cnt;           /* Shared pages copied on write. */
+static long long zero_map_cnt;       /* Pages mapped to the zero page. */
+static long long zero_copy_cnt;      /* Of those, pages written later. */
+static long long around_cnt;         /* Pages mapped around a fault. */
+static long long around_read_cnt;    /* Of those, pages read from file. */
+static long long stack_grow_cnt;     /* Number of times the stack grew. */
+static long long prefault_cnt;       /* Stack pages brought in early. */
+static long long large_cnt;          /* Large pages mapped. */
+static long long large_fail_cnt;     /* Large pages that did not fit. */
+static long long limit_evict_cnt;    /* Frames evicted over RSS limits. */
+static long long slot_release_cnt;   /* Swap slots released on write. */
+
+/* A page of zeros, mapped read-only to anonymous pages that have only been
+   read so far. */
+static void *zero_page;
+
+/* Private pages of an area that are aligned to `PTSPAN` can be backed by a
+   single large page instead, when the CPU supports it and the user pool has
+   enough aligned contiguous frames.  Large pages are neither shared nor
+   evicted. */
+#define LARGE_PAGE_CNT (PTSPAN / PGSIZE)
+
+struct large_page
+{
+  void *upage;           /* User virtual address. */
+  void *kpage;           /* Kernel virtual address of the frames. */
+  struct list_elem elem; /* Element in `large_pages` of its area. */
+};
+
+/* Descriptors of large pages. */
+static struct slab_cache large_page_cache
+    = SLAB_CACHE_INITIALIZER ("large page", struct large_page);
+
+static bool large_pages_enabled;
+
+static struct mmap_info *materialize (struct vma *, void *);
+static void *alloc_user_page (void);
+
 /* Add a non-mapped user page `upage` to page table. */
 static bool
 install_page_stub (void *upage, bool writable)
@@ -31,240 +106,1162 @@ install_page_stub (void *upage, bool writable)
           && pagedir_set_page_stub (cur->pagedir, upage, writable));
 }
 
-/* Initialize virtual memory manager. */
-bool
-vmm_init (void)
-{
-  struct thread *cur;
+/* Set the swap-in read-ahead window to `window` pages.  Zero disables
+   read-ahead. */
+void
+vmm_set_readahead (size_t window)
+{
+  readahead_window
+      = window < SWAP_CLUSTER_PAGES ? window : SWAP_CLUSTER_PAGES - 1;
+}
+
+/* Set the initial stack reservation to `page_cnt` pages. */
+void
+vmm_set_stack_reserve (size_t page_cnt)
+{
+  stack_initial_pages = page_cnt;
+}
+
+/* Set the resident set limit of new processes to `page_cnt` pages.  Zero
+   means no limit. */
+void
+vmm_set_default_rss_limit (size_t page_cnt)
+{
+  default_rss_limit = page_cnt;
+}
+
+/* Set the resident set limit of the current process to `page_cnt` pages.
+   Zero means no limit.  Pages over the limit are evicted as the process
+   faults in new ones. */
+void
+vmm_set_rss_limit (size_t page_cnt)
+{
+  thread_current ()->rss_limit = page_cnt;
+}
+
+/* Set the fault-around window to `window` pages.  Zero or one disables
+   fault-around. */
+void
+vmm_set_fault_around (size_t window)
+{
+  fault_around_window = window;
+}
+
+/* Account for a read-ahead page that is evicted or freed without being used. */
+static void
+drop_prefetched (struct frame *frame)
+{
+  if (!frame->prefetched)
+    return;
+  frame->prefetched = false;
+  readahead_miss_cnt++;
+}
+
+/* Returns true if `vma` may back its pages with large pages. */
+static bool
+wants_large_pages (const struct vma *vma)
+{
+  return large_pages_enabled && vma->writable && !vma->grows_down
+         && (vma->file == NULL || vma->exe_mapping);
+}
+
+/* Add `delta` pages to the resident set of `t`.  Frames are evicted by other
+   threads, too. */
+static void
+add_resident (struct thread *t, int delta)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  t->rss += delta;
+  intr_set_level (old_level);
+}
+
+/* Map a large page of `vma` at `upage`, which must be aligned to `PTSPAN`,
+   in the current process, filled like the pages it replaces.  If `src` is not
+   NULL, copy it from there instead.  Returns false if there are no aligned
+   frames for it. */
+static bool
+install_large_page (struct vma *vma, void *upage, const void *src)
+{
+  struct large_page *lp;
+  uint32_t pos, size;
+
+  lp = slab_alloc (&large_page_cache);
+  if (lp == NULL)
+    return false;
+  lp->upage = upage;
+  lp->kpage = palloc_get_aligned (PAL_USER | (src == NULL ? PAL_ZERO : 0),
+                                  LARGE_PAGE_CNT, LARGE_PAGE_CNT);
+  if (lp->kpage == NULL)
+    {
+      slab_free (&large_page_cache, lp);
+      large_fail_cnt++;
+      return false;
+    }
+
+  pos = (uint8_t *)upage - (uint8_t *)vma->start;
+  if (src != NULL)
+    memcpy (lp->kpage, src, PTSPAN);
+  else if (vma->file != NULL && pos < vma->file_size)
+    {
+      size = vma->file_size - pos < PTSPAN ? vma->file_size - pos : PTSPAN;
+      file_read_at (vma->file, lp->kpage, size, vma->offset + pos);
+    }
+
+  if (!pagedir_set_large_page (thread_current ()->pagedir, upage, lp->kpage,
+                               true))
+    {
+      palloc_free_multiple (lp->kpage, LARGE_PAGE_CNT);
+      slab_free (&large_page_cache, lp);
+      return false;
+    }
+  list_push_back (&vma->large_pages, &lp->elem);
+  add_resident (thread_current (), LARGE_PAGE_CNT);
+  large_cnt++;
+  return true;
+}
+
+/* Back the `PTSPAN`-aligned range of `vma` around `upage`, which just
+   faulted, with a large page, if the range lies within the area and none of
+   its pages has been touched yet.  Returns true if successful. */
+static bool
+map_large_page (struct vma *vma, void *upage)
+{
+  struct list_elem *el;
+  uint8_t *start;
+  void *page;
+
+  if (!wants_large_pages (vma))
+    return false;
+
+  /* A large page would take a limited resident set far over its limit. */
+  if (thread_current ()->rss_limit != 0)
+    return false;
+
+  start = (uint8_t *)((uintptr_t)upage & ~(uintptr_t)(PTSPAN - 1));
+  if (start < (uint8_t *)vma->start
+      || (uint8_t *)vma->end - start < (ptrdiff_t)PTSPAN)
+    return false;
+
+  /* Pages brought in one by one stay that way. */
+  for (el = list_begin (&vma->pages); el != list_end (&vma->pages);
+       el = list_next (el))
+    {
+      page = list_entry (el, struct mmap_info, vma_elem)->upage;
+      if ((uint8_t *)page >= start && (uint8_t *)page - start < PTSPAN)
+        return false;
+    }
+
+  return install_large_page (vma, start, NULL);
+}
+
+/* Copy the large page `src` of another process into `vma` of the current
+   process.  If there are no aligned frames for it, it is copied into
+   ordinary pages instead.  Returns false if memory runs out. */
+static bool
+copy_large_page (struct vma *vma, struct large_page *src)
+{
+  struct mmap_info *info;
+  struct frame *frame;
+  void *kpage;
+  size_t i;
+  bool success;
+
+  if (install_large_page (vma, src->upage, src->kpage))
+    return true;
+
+  for (i = 0; i < LARGE_PAGE_CNT; i++)
+    {
+      info = materialize (vma, (uint8_t *)src->upage + i * PGSIZE);
+      if (info == NULL)
+        return false;
+      frame = info->frame;
+      lock_acquire (&frame->lock);
+      kpage = alloc_user_page ();
+      success = kpage != NULL && vmm_activate_frame (frame, kpage);
+      if (success)
+        memcpy (kpage, (uint8_t *)src->kpage + i * PGSIZE, PGSIZE);
+      lock_release (&frame->lock);
+      if (!success)
+        return false;
+    }
+  return true;
+}
+
+/* Unmap and free the large pages of `vma` of the current process. */
+static void
+free_large_pages (struct vma *vma)
+{
+  struct large_page *lp;
+
+  while (!list_empty (&vma->large_pages))
+    {
+      lp = list_entry (list_pop_front (&vma->large_pages), struct large_page,
+                       elem);
+      pagedir_clear_large_page (thread_current ()->pagedir, lp->upage);
+      palloc_free_multiple (lp->kpage, LARGE_PAGE_CNT);
+      add_resident (thread_current (), -LARGE_PAGE_CNT);
+      slab_free (&large_page_cache, lp);
+    }
+}
+
+/* Add `delta` pages to the resident set of the process `info` belongs to. */
+static void
+count_resident (struct mmap_info *info, int delta)
+{
+  add_resident (info->owner, delta);
+}
+
+/* Like `count_resident`, for every mapping of `frame`.  The caller must hold
+   the lock of `frame`. */
+static void
+count_resident_frame (struct frame *frame, int delta)
+{
+  struct list_elem *el;
+
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    count_resident (list_entry (el, struct mmap_info, elem), delta);
+}
+
+/* Returns true if the current process is at or over its resident set
+   limit. */
+static bool
+over_rss_limit (void)
+{
+  struct thread *cur;
+
+  cur = thread_current ();
+  return cur->rss_limit != 0 && cur->rss >= cur->rss_limit;
+}
+
+/* Returns true if `frame` backs mappings of more than one page. */
+static bool
+is_shared (struct frame *frame)
+{
+  return !list_empty (&frame->mappings)
+         && list_begin (&frame->mappings) != list_rbegin (&frame->mappings);
+}
+
+/* Returns true if `info` may be installed writable in its page directory.
+   A frame that keeps its swap slot is installed read-only, so that the first
+   write to it releases the slot, whose copy is stale from then on. */
+static bool
+mapping_writable (struct frame *frame, struct mmap_info *info)
+{
+  return info->writable && !is_shared (frame) && !swap_has_slot (frame);
+}
+
+/* Set the write bit of every installed mapping of `frame` according to
+   whether the frame is shared.  The caller must hold the lock of `frame`. */
+static void
+update_protection (struct frame *frame)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+
+  if (frame->kpage == NULL || frame->prefetched)
+    return;
+
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    {
+      info = list_entry (el, struct mmap_info, elem);
+      pagedir_set_writable (info->pagedir, info->upage,
+                            mapping_writable (frame, info));
+    }
+}
+
+/* Detach `info` from its frame and clear it from its page directory.  The
+   frame is freed along with its last mapping. */
+static void
+detach_mapping (struct mmap_info *info)
+{
+  struct frame *frame;
+  bool orphaned, text;
+
+  frame = info->frame;
+
+  /* A frame in the text cache must leave it along with its last mapping,
+     before anyone can look it up again.  It stays there for its lifetime, so
+     checking without its lock is fine. */
+  text = frame->text_inode != NULL;
+  if (text)
+    text_acquire ();
+
+  /* Wait for a pending eviction of this frame to finish. */
+  lock_acquire (&frame->lock);
+
+  pagedir_clear_page (info->pagedir, info->upage);
+  if (frame->kpage != NULL && !frame->prefetched)
+    count_resident (info, -1);
+  list_remove (&info->elem);
+  orphaned = list_empty (&frame->mappings);
+  if (orphaned)
+    {
+      if (text)
+        text_remove (frame);
+      drop_prefetched (frame);
+      if (frame->kpage != NULL)
+        {
+          swap_unregister_frame (frame);
+          palloc_free_page (frame->kpage);
+          frame->kpage = NULL;
+        }
+      swap_free_frame (frame);
+    }
+  else
+    update_protection (frame);
+
+  lock_release (&frame->lock);
+  if (text)
+    text_release ();
+
+  /* Nobody else can reach an orphaned frame: it is out of the frame table, and
+     no mapping points to it. */
+  if (orphaned)
+    frame_free (frame);
+}
+
+/* Allocate the shared zero page. */
+void
+vmm_init_zero_page (void)
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+/* Use large pages where possible, if the CPU supports them. */
+void
+vmm_init_large_pages (void)
+{
+  large_pages_enabled = pagedir_enable_large_pages ();
+}
+
+/* Initialize virtual memory manager. */
+bool
+vmm_init (void)
+{
+  struct thread *cur;
+
+  cur = thread_current ();
+
+  list_init (&cur->mmap_blocks);
+  vma_tree_init (&cur->vmas);
+  cur->stack_grow_ticks = 0;
+  cur->stack_grow_pages = 0;
+  cur->rss_limit = default_rss_limit;
+  fault_profile_create ();
+  return hash_init (&cur->mmaps, mmap_info_hash, mmap_info_less, NULL);
+}
+
+/* Destroy VMM related data structures. */
+void
+vmm_destroy (void)
+{
+  struct thread *cur;
+  struct hash_iterator i;
+  struct vma *vma;
+
+  cur = thread_current ();
+  fault_profile_destroy ();
+
+  /* Frames shared with other processes outlive this one. */
+  hash_first (&i, &cur->mmaps);
+  while (hash_next (&i))
+    detach_mapping (hash_entry (hash_cur (&i), struct mmap_info, map_elem));
+
+  hash_destroy (&cur->mmaps, mmap_info_destruct);
+
+  while ((vma = vma_first (&cur->vmas)) != NULL)
+    {
+      vma_remove (&cur->vmas, vma);
+      free_large_pages (vma);
+      free (vma);
+    }
+}
+
+/* Create a new frame and map `info` to it. */
+bool
+vmm_map_to_new_frame (struct mmap_info *info)
+{
+  struct frame *frame;
+  struct thread *cur;
+
+  cur = thread_current ();
+  if (hash_find (&cur->mmaps, &info->map_elem))
+    return false;
+
+  frame = frame_alloc ();
+  if (frame == NULL)
+    return false;
+  frame_init (frame);
+
+  list_push_back (&frame->mappings, &info->elem);
+  info->frame = frame;
+  hash_insert (&cur->mmaps, &info->map_elem);
+
+  return install_page_stub (info->upage, info->writable);
+}
+
+/* Create an anonymous mapping for `upage`. */
+static struct mmap_info *
+vmm_create_anonymous (void *upage, bool writable)
+{
+  struct mmap_info *info;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  info = mmap_info_alloc ();
+  if (info == NULL)
+    return NULL;
+  mmap_init_anonymous (info, upage, writable);
+
+  if (!vmm_map_to_new_frame (info))
+    {
+      mmap_info_free (info);
+      return NULL;
+    }
+  return info;
+}
+
+/* Create a file mapping for `file` to `upage`. */
+static struct mmap_info *
+vmm_create_file_map (void *upage, struct file *file, bool writable,
+                     bool exe_mapping, off_t offset, uint32_t size)
+{
+  struct mmap_info *info;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  info = mmap_info_alloc ();
+  if (info == NULL)
+    return NULL;
+  mmap_init_file_map (info, upage, file, writable, exe_mapping, offset, size);
+
+  if (!vmm_map_to_new_frame (info))
+    {
+      mmap_info_free (info);
+      return NULL;
+    }
+  return info;
+}
+
+/* Remove mapping info. */
+void
+vmm_remove_mapping (struct mmap_info *info)
+{
+  list_remove (&info->vma_elem);
+  hash_delete (&thread_current ()->mmaps, &info->map_elem);
+  detach_mapping (info);
+  mmap_info_free (info);
+}
+
+/* Find the mapping of `upage` in the address space of `t`. */
+static struct mmap_info *
+lookup_mapping (struct thread *t, void *upage)
+{
+  struct mmap_info info;
+  struct hash_elem *el;
+
+  info.upage = upage;
+  el = hash_find (&t->mmaps, &info.map_elem);
+
+  return el != NULL ? hash_entry (el, struct mmap_info, map_elem) : NULL;
+}
+
+/* Find page frame corresponding to `upage`. */
+struct frame *
+vmm_lookup_frame (void *upage)
+{
+  struct mmap_info *info;
+
+  info = lookup_mapping (thread_current (), upage);
+  return info != NULL ? info->frame : NULL;
+}
+
+/* Map `info` of the current process to `frame`, which backs mappings of
+   other processes, sharing it copy-on-write.  The caller must hold the lock
+   of `frame`.  Returns false on failure. */
+static bool
+attach_mapping (struct frame *frame, struct mmap_info *info)
+{
+  struct thread *cur;
+
+  cur = thread_current ();
+  if (hash_find (&cur->mmaps, &info->map_elem) != NULL
+      || !install_page_stub (info->upage, info->writable))
+    return false;
+  hash_insert (&cur->mmaps, &info->map_elem);
+  list_push_back (&frame->mappings, &info->elem);
+  info->frame = frame;
+
+  /* A resident frame is installed in every page directory it is mapped in.
+     The page table for `upage` exists by now, so this cannot fail. */
+  if (frame->kpage != NULL && !frame->prefetched)
+    {
+      pagedir_set_page (info->pagedir, info->upage, frame->kpage, false);
+      count_resident (info, 1);
+      update_protection (frame);
+    }
+  share_cnt++;
+  return true;
+}
+
+/* Add `info` to the pages of `vma`.  The pages of mmap areas are walked by
+   the writeback daemon, so they are added under its lock. */
+static void
+link_page (struct vma *vma, struct mmap_info *info)
+{
+  info->vma = vma;
+  if (vma->file != NULL && !vma->exe_mapping)
+    writeback_link_page (vma, info);
+  else
+    list_push_back (&vma->pages, &info->vma_elem);
+}
+
+/* Map `src`, a mapping of another process, to the same page of `vma` of
+   the current process.  The new mapping shares the frame of `src`
+   copy-on-write, unless there is nothing to share yet.  Returns NULL on
+   failure. */
+static struct mmap_info *
+share_mapping (struct mmap_info *src, struct vma *vma)
+{
+  struct mmap_info *info;
+  struct frame *frame;
+  bool success;
+
+  info = mmap_info_alloc ();
+  if (info == NULL)
+    return NULL;
+  if (src->file != NULL)
+    mmap_init_file_map (info, src->upage, vma->file, src->writable,
+                        src->exe_mapping, src->offset, src->mapped_size);
+  else
+    mmap_init_anonymous (info, src->upage, src->writable);
+
+  frame = src->frame;
+  lock_acquire (&frame->lock);
+
+  /* A writable frame that was never loaded would be copied on its first
+     write anyway. */
+  if (frame->is_stub && info->writable)
+    {
+      lock_release (&frame->lock);
+      success = vmm_map_to_new_frame (info);
+    }
+  else
+    {
+      success = attach_mapping (frame, info);
+      lock_release (&frame->lock);
+    }
+
+  if (!success)
+    {
+      mmap_info_free (info);
+      return NULL;
+    }
+  link_page (vma, info);
+  return info;
+}
+
+/* Create a mapping of executable `file` to `upage`, like
+   `vmm_create_file_map`.  Read-only pages are shared through the text cache
+   with every other process that runs the same executable. */
+static struct mmap_info *
+vmm_create_exe_map (void *upage, struct file *file, bool writable,
+                    off_t offset, uint32_t size)
+{
+  struct mmap_info *info, *first;
+  struct inode *inode;
+  struct frame *frame;
+  bool shared, success;
+
+  if (writable)
+    return vmm_create_file_map (upage, file, true, true, offset, size);
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  info = mmap_info_alloc ();
+  if (info == NULL)
+    return NULL;
+  mmap_init_file_map (info, upage, file, false, true, offset, size);
+  inode = file_get_inode (file);
+
+  text_acquire ();
+
+  /* Segments of a different layout may map the same page of the file with a
+     different size, and zero-fill the rest.  Such a page is not shared. */
+  shared = success = false;
+  frame = text_lookup (inode, offset);
+  if (frame != NULL)
+    {
+      lock_acquire (&frame->lock);
+      first = list_entry (list_front (&frame->mappings), struct mmap_info,
+                          elem);
+      if (first->mapped_size == size)
+        {
+          shared = true;
+          success = attach_mapping (frame, info);
+        }
+      lock_release (&frame->lock);
+    }
+  if (!shared)
+    {
+      success = vmm_map_to_new_frame (info);
+      if (success && frame == NULL)
+        text_insert (info->frame, inode, offset);
+    }
+
+  text_release ();
+
+  if (!success)
+    {
+      mmap_info_free (info);
+      return NULL;
+    }
+  return info;
+}
+
+/* Share the address space of `parent`, which must be blocked, with the
+   current process copy-on-write.  Executable areas of the current process
+   are backed by `exe_file`.  Memory-mapped files are not inherited. */
+bool
+vmm_fork (struct thread *parent, struct file *exe_file)
+{
+  struct thread *cur;
+  struct vma *src, *vma;
+  struct list_elem *el;
+
+  cur = thread_current ();
+  cur->rss_limit = parent->rss_limit;
+  for (src = vma_first (&parent->vmas); src != NULL;
+       src = vma_next (&parent->vmas, src))
+    {
+      if (src->file != NULL && !src->exe_mapping)
+        continue;
+
+      vma = malloc (sizeof (struct vma));
+      if (vma == NULL)
+        return false;
+      vma_init (vma, src->start, src->end,
+                src->file != NULL ? exe_file : NULL, src->offset,
+                src->file_size, src->writable, src->exe_mapping);
+      vma->grows_down = src->grows_down;
+      vma_insert (&cur->vmas, vma);
+
+      for (el = list_begin (&src->pages); el != list_end (&src->pages);
+           el = list_next (el))
+        if (share_mapping (list_entry (el, struct mmap_info, vma_elem), vma)
+            == NULL)
+          return false;
+
+      for (el = list_begin (&src->large_pages);
+           el != list_end (&src->large_pages); el = list_next (el))
+        if (!copy_large_page (vma, list_entry (el, struct large_page, elem)))
+          return false;
+    }
+
+  return true;
+}
+
+/* Create an area of `page_cnt` pages from `upage` on in the address space of
+   the current process.  The first `file_size` bytes are backed by `file`
+   from `offset` on, unless `file` is NULL.  Nothing is allocated for the
+   pages themselves until they are touched.  Returns NULL if the area does
+   not fit in user space or overlaps another one. */
+struct vma *
+vmm_create_vma (void *upage, size_t page_cnt, struct file *file, off_t offset,
+                uint32_t file_size, bool writable, bool exe_mapping)
+{
+  struct vma *vma, *above;
+  void *end;
+
+  end = (uint8_t *)upage + page_cnt * PGSIZE;
+  if (pg_ofs (upage) != 0 || upage == NULL || page_cnt == 0
+      || !is_user_vaddr (upage)
+      || page_cnt > (size_t)((uint8_t *)PHYS_BASE - (uint8_t *)upage) / PGSIZE)
+    return NULL;
+
+  /* The last page must not be the guard page of a stack. */
+  above = vma_find (&thread_current ()->vmas, end);
+  if (above != NULL && above->grows_down)
+    return NULL;
+
+  vma = malloc (sizeof (struct vma));
+  if (vma == NULL)
+    return NULL;
+  vma_init (vma, upage, end, file, offset, file_size, writable, exe_mapping);
+  if (!vma_insert (&thread_current ()->vmas, vma))
+    {
+      free (vma);
+      return NULL;
+    }
+  return vma;
+}
+
+/* Create the mapping of `upage` in `vma` of the current process, when the
+   page is first touched. */
+static struct mmap_info *
+materialize (struct vma *vma, void *upage)
+{
+  struct mmap_info *info;
+  uint32_t pos, size;
+
+  pos = (uint8_t *)upage - (uint8_t *)vma->start;
+  size = 0;
+  if (pos < vma->file_size)
+    size = vma->file_size - pos < PGSIZE ? vma->file_size - pos : PGSIZE;
+
+  if (vma->file == NULL)
+    info = vmm_create_anonymous (upage, vma->writable);
+  else if (vma->exe_mapping)
+    info = vmm_create_exe_map (upage, vma->file, vma->writable,
+                               vma->offset + pos, size);
+  else
+    info = vmm_create_file_map (upage, vma->file, vma->writable, false,
+                                vma->offset + pos, size);
+  if (info == NULL)
+    return NULL;
+
+  link_page (vma, info);
+  return info;
+}
+
+/* Install every mapping of the resident `frame` in its page directory. */
+static bool
+install_frame (struct frame *frame)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+
+  for (el = list_begin (&frame->mappings); el != list_end (&frame->mappings);
+       el = list_next (el))
+    {
+      info = list_entry (el, struct mmap_info, elem);
+      if (!pagedir_set_page (info->pagedir, info->upage, frame->kpage,
+                             mapping_writable (frame, info)))
+        return false;
+      count_resident (info, 1);
+    }
+  return true;
+}
+
+/* Deserialize frame from disk.  The caller must hold the lock of `frame`. */
+bool
+vmm_activate_frame (struct frame *frame, void *kpage)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+  bool read_from_file;
+  size_t zero_bytes;
+
+  ASSERT (lock_held_by_current_thread (&frame->lock));
+
+  frame->kpage = kpage;
+  if (frame->is_swapped_out)
+    {
+      swap_read_frame (frame);
+      thread_current ()->swapin_cnt++;
+      fault_note (FAULT_SWAP);
+      if (!install_frame (frame))
+        return false;
+    }
+  else
+    {
+      /* Fill the page before any process can see it.  Processes sharing
+         the frame map the same page of the file. */
+      read_from_file = false;
+      for (el = list_begin (&frame->mappings);
+           el != list_end (&frame->mappings) && !read_from_file;
+           el = list_next (el))
+        {
+          info = list_entry (el, struct mmap_info, elem);
+          if (info->file != NULL)
+            {
+              file_read_at (info->file, kpage, info->mapped_size,
+                            info->offset);
+              zero_bytes = PGSIZE - info->mapped_size;
+              memset (kpage + info->mapped_size, 0, zero_bytes);
+              read_from_file = true;
+              fault_note (FAULT_FILE);
+            }
+        }
+
+      if (frame->is_stub && !read_from_file)
+        {
+          memset (kpage, 0, PGSIZE);
+          fault_note (FAULT_ZERO);
+        }
+
+      for (el = list_begin (&frame->mappings);
+           el != list_end (&frame->mappings); el = list_next (el))
+        {
+          info = list_entry (el, struct mmap_info, elem);
 
-  cur = thread_current ();
+          /* The page may map the zero page so far. */
+          pagedir_clear_page (info->pagedir, info->upage);
+          if (!pagedir_set_page (info->pagedir, info->upage, kpage,
+                                 mapping_writable (frame, info)))
+            return false;
+          count_resident (info, 1);
+        }
+    }
 
-  list_init (&cur->frames);
-  list_init (&cur->mmap_blocks);
-  return hash_init (&cur->mmaps, mmap_info_hash, mmap_info_less, NULL);
+  frame->is_stub = false;
+  frame->is_swapped_out = false;
+  swap_register_frame (frame);
+
+  return true;
 }
 
-/* Destroy VMM related data structures. */
-void
-vmm_destroy (void)
+/* Swap in `frame`, which is mapped at `upage` of the current process, into
+   `kpage`.  Following pages of the process whose swap slots directly follow
+   the one of `frame` are read along with it in the same request, into free
+   frames only.  They are not mapped until they are first touched, so that
+   unused read-ahead pages stay cheap to evict.  The caller must hold the lock
+   of `frame`. */
+static bool
+swap_in_with_readahead (struct frame *frame, void *upage, void *kpage)
 {
-  struct thread *cur;
-  struct list_elem *el;
-  struct frame *frame;
+  struct frame *run[SWAP_CLUSTER_PAGES], *next;
+  size_t cnt, i;
 
-  cur = thread_current ();
-  while (!list_empty (&cur->frames))
+  run[0] = frame;
+  frame->kpage = kpage;
+  for (cnt = 1; cnt <= readahead_window; cnt++)
     {
-      el = list_pop_front (&cur->frames);
-      frame = list_entry (el, struct frame, elem);
-      if (frame->kpage != NULL)
+      next = vmm_lookup_frame (upage + cnt * PGSIZE);
+      if (next == NULL || !lock_try_acquire (&next->lock))
+        break;
+      if (next->kpage != NULL || !swap_slots_adjacent (run[cnt - 1], next)
+          || (next->kpage = palloc_get_page (PAL_USER)) == NULL)
         {
-          palloc_free_page (frame->kpage);
-          swap_unregister_frame (frame);
+          lock_release (&next->lock);
+          break;
         }
-      else if (frame->is_swapped_out)
-        swap_free_frame (frame);
-      free (frame);
+      run[cnt] = next;
     }
 
-  hash_destroy (&cur->mmaps, mmap_info_destruct);
-}
-
-/* Create a new frame and map `info` to it. */
-bool
-vmm_map_to_new_frame (struct mmap_info *info)
-{
-  struct frame *frame;
-  struct thread *cur;
-
-  cur = thread_current ();
-  if (hash_find (&cur->mmaps, &info->map_elem))
-    return false;
+  swap_read_frames (run, cnt);
+  thread_current ()->swapin_cnt += cnt;
+  fault_note (FAULT_SWAP);
 
-  frame = malloc (sizeof (struct frame));
-  if (frame == NULL)
+  for (i = 0; i < cnt; i++)
     {
-      free (info);
-      return false;
+      run[i]->is_stub = false;
+      run[i]->is_swapped_out = false;
+      if (i > 0)
+        {
+          run[i]->prefetched = true;
+          readahead_cnt++;
+        }
+      swap_register_frame (run[i]);
+      if (i > 0)
+        lock_release (&run[i]->lock);
     }
-  frame_init (frame);
-
-  list_push_back (&frame->mappings, &info->elem);
-  info->frame = frame;
-  list_push_back (&cur->frames, &frame->elem);
-  hash_insert (&cur->mmaps, &info->map_elem);
 
-  return install_page_stub (info->upage, info->writable);
+  return install_frame (frame);
 }
 
-/* Create an anonymous mapping for `upage`. */
-struct mmap_info *
-vmm_create_anonymous (void *upage, bool writable)
+/* Get a page from the user pool.  Normally the page-out daemon keeps some
+   frames free.  Evict a frame ourselves only if it could not keep up.
+   Returns NULL if no frame could be evicted. */
+static void *
+alloc_user_page (void)
 {
-  struct mmap_info *info;
-
-  ASSERT (pg_ofs (upage) == 0);
+  void *kpage;
+  struct frame *victim;
 
-  info = malloc (sizeof (struct mmap_info));
-  if (info == NULL)
-    return NULL;
-  mmap_init_anonymous (info, upage, writable);
+  /* A process at its resident set limit pays for the page itself. */
+  if (over_rss_limit () && swap_is_present ())
+    {
+      victim = swap_find_victim_of (thread_current ());
+      if (victim != NULL)
+        {
+          if (vmm_deactivate_frame (victim))
+            limit_evict_cnt++;
+          fault_note (FAULT_EVICT);
+          lock_release (&victim->lock);
+        }
+    }
 
-  if (!vmm_map_to_new_frame (info))
+  while ((kpage = palloc_get_page (PAL_USER)) == NULL)
     {
-      free (info);
-      return NULL;
+      pageout_wake ();
+      victim = swap_find_victim ();
+      if (victim == NULL)
+        return NULL;
+      if (!vmm_deactivate_frame (victim))
+        {
+          /* Swap space is full. */
+          lock_release (&victim->lock);
+          return NULL;
+        }
+      lock_release (&victim->lock);
+      fault_note (FAULT_EVICT);
     }
-  return info;
+
+  pageout_wake ();
+  return kpage;
 }
 
-/* Create a file mapping for `file` to `upage`. */
-struct mmap_info *
-vmm_create_file_map (void *upage, struct file *file, bool writable,
-                     bool exe_mapping, off_t offset, uint32_t size)
+/* Create the mapping of `upage` in `vma` of the current process before it is
+   touched.  Unless its frame is resident already, it is brought in, but only
+   into a free frame, so that nothing is evicted for a page that may never be
+   touched.  Sets `loaded` to whether a frame had to be brought in.  Returns
+   false if the page could not be mapped. */
+static bool
+populate (struct vma *vma, void *upage, bool *loaded)
 {
   struct mmap_info *info;
+  struct frame *frame;
+  void *kpage;
+  bool success;
 
-  ASSERT (pg_ofs (upage) == 0);
-
-  info = malloc (sizeof (struct mmap_info));
+  if (over_rss_limit ())
+    return false;
+  info = materialize (vma, upage);
   if (info == NULL)
-    return NULL;
-  mmap_init_file_map (info, upage, file, writable, exe_mapping, offset, size);
+    return false;
 
-  if (!vmm_map_to_new_frame (info))
+  frame = info->frame;
+  lock_acquire (&frame->lock);
+  success = true;
+  *loaded = frame->kpage == NULL;
+  if (*loaded)
     {
-      free (info);
-      return NULL;
+      kpage = palloc_get_page (PAL_USER);
+      success = kpage != NULL && vmm_activate_frame (frame, kpage);
     }
-  return info;
+  lock_release (&frame->lock);
+  return success;
 }
 
-/* Remove mapping info. */
-void
-vmm_remove_mapping (struct mmap_info *info)
+/* Map the pages of read-only executable `vma` around `upage`, which just
+   faulted, in the aligned window of `fault_around_window` pages containing
+   it.  Code near a fault is nearly always run next.  Pages found in the text
+   cache are mapped as they are; the others are read from the file. */
+static void
+fault_around (struct vma *vma, void *upage)
 {
   struct thread *cur;
+  uint8_t *start, *end, *page;
+  size_t idx;
+  bool loaded;
+
+  if (fault_around_window <= 1 || vma->file == NULL || !vma->exe_mapping
+      || vma->writable)
+    return;
 
   cur = thread_current ();
-  pagedir_clear_page (cur->pagedir, info->upage);
-  hash_delete (&cur->mmaps, &info->map_elem);
-  mmap_info_destruct (&info->map_elem, NULL);
+  idx = pg_no (upage) - pg_no (vma->start);
+  start = (uint8_t *)upage - idx % fault_around_window * PGSIZE;
+  end = start + fault_around_window * PGSIZE;
+  if (end > (uint8_t *)vma->end || end < start)
+    end = vma->end;
+
+  for (page = start; page < end; page += PGSIZE)
+    {
+      if (page == upage || lookup_mapping (cur, page) != NULL)
+        continue;
+      if (!populate (vma, page, &loaded))
+        return;
+      around_cnt++;
+      if (loaded)
+        around_read_cnt++;
+    }
 }
 
-/* Find page frame corresponding to `upage`. */
-struct frame *
-vmm_lookup_frame (void *upage)
+/* Bring the pages of `vma` from `start` up to `end` in ahead of their first
+   touch, as long as there are free frames.  Stack pages get zeroed frames of
+   their own rather than the zero page, since they are written right away and
+   would fault again on the first write. */
+static void
+prefault (struct vma *vma, void *start, void *end)
 {
-  struct mmap_info info;
-  struct hash_elem *el;
   struct thread *cur;
-
-  info.upage = upage;
+  uint8_t *page;
+  bool loaded;
 
   cur = thread_current ();
-  el = hash_find (&cur->mmaps, &info.map_elem);
-
-  return el != NULL ? hash_entry (el, struct mmap_info, map_elem)->frame : NULL;
+  for (page = start; page < (uint8_t *)end; page += PGSIZE)
+    {
+      if (lookup_mapping (cur, page) != NULL)
+        continue;
+      if (!populate (vma, page, &loaded))
+        return;
+      if (loaded)
+        prefault_cnt++;
+    }
 }
 
-/* Deserialize frame from disk. */
+/* Handle page faults caused by non-present page access.  `write` tells
+   whether the access was a write. */
 bool
-vmm_activate_frame (struct frame *frame, void *kpage)
+vmm_handle_not_present (void *fault_addr, bool write)
 {
-  struct thread *cur;
-  struct list_elem *el;
+  void *kpage, *upage;
   struct mmap_info *info;
-  bool read_from_file;
-  size_t zero_bytes;
+  struct vma *vma;
+  struct frame *frame;
+  bool success;
 
-  cur = thread_current ();
+  upage = pg_round_down (fault_addr);
+  info = lookup_mapping (thread_current (), upage);
+  if (info == NULL)
+    {
+      vma = vma_find (&thread_current ()->vmas, upage);
+      if (vma == NULL)
+        return false;
+      if (map_large_page (vma, upage))
+        return true;
+      if ((info = materialize (vma, upage)) == NULL)
+        return false;
+    }
+  frame = info->frame;
 
-  frame->kpage = kpage;
-  if (frame->is_swapped_out)
+  lock_acquire (&frame->lock);
+
+  /* Reading an untouched anonymous page needs no frame of its own.  The
+     frame is allocated when the page is first written.  A page of an
+     executable with nothing to read from the file, such as BSS, counts as
+     anonymous; pages of `mmap`ed files are always read. */
+  if (!write && frame->is_stub && frame->kpage == NULL
+      && (info->file == NULL
+          || (info->exe_mapping && info->mapped_size == 0))
+      && !is_shared (frame))
     {
-      swap_read_frame (frame);
-      for (el = list_begin (&frame->mappings);
-           el != list_end (&frame->mappings); el = list_next (el))
-        {
-          info = list_entry (el, struct mmap_info, elem);
-          if (!pagedir_set_page (cur->pagedir, info->upage, kpage,
-                                 info->writable))
-            return false;
-        }
+      success = pagedir_set_page (info->pagedir, upage, zero_page, false);
+      if (success)
+        zero_map_cnt++;
+      lock_release (&frame->lock);
+      return success;
     }
-  else
+
+  /* The frame may have been read ahead, or brought in while we were waiting
+     for an eviction of it to complete. */
+  if (frame->kpage != NULL)
     {
-      read_from_file = false;
-      for (el = list_begin (&frame->mappings);
-           el != list_end (&frame->mappings); el = list_next (el))
+      success = true;
+      if (frame->prefetched)
         {
-          info = list_entry (el, struct mmap_info, elem);
-          if (!pagedir_set_page (cur->pagedir, info->upage, kpage,
-                                 info->writable))
-            return false;
-          if (info->file != NULL)
-            {
-              ASSERT (!read_from_file);
-
-              file_seek (info->file, info->offset);
-              file_read (info->file, kpage, info->mapped_size);
-              zero_bytes = PGSIZE - info->mapped_size;
-              memset (kpage + info->mapped_size, 0, zero_bytes);
-              read_from_file = true;
-            }
+          frame->prefetched = false;
+          readahead_hit_cnt++;
+          success = install_frame (frame);
         }
+      lock_release (&frame->lock);
+      return success;
+    }
 
-      if (frame->is_stub && !read_from_file)
-        memset (kpage, 0, PGSIZE);
+  kpage = alloc_user_page ();
+  if (kpage == NULL)
+    {
+      lock_release (&frame->lock);
+      return false;
     }
 
-  frame->is_stub = false;
-  frame->is_swapped_out = false;
-  swap_register_frame (frame);
+  if (frame->is_swapped_out && readahead_window > 0)
+    success = swap_in_with_readahead (frame, upage, kpage);
+  else
+    success = vmm_activate_frame (frame, kpage);
+  lock_release (&frame->lock);
 
-  return true;
+  if (success)
+    fault_around (info->vma, upage);
+  return success;
 }
 
-/* Handle page faults caused by non-present page access. */
+/* Handle page faults caused by writing to a read-only page.  If the page is
+   writable but its frame is shared, give the current process a private copy
+   of the frame.  Returns false if the page is not writable. */
 bool
-vmm_handle_not_present (void *fault_addr)
+vmm_handle_write_protect (void *fault_addr)
 {
   void *kpage, *upage;
-  struct frame *frame, *victim;
+  struct mmap_info *info;
+  struct frame *frame, *copy;
+  bool success;
 
   upage = pg_round_down (fault_addr);
-  frame = vmm_lookup_frame (upage);
-  if (frame == NULL)
+  info = lookup_mapping (thread_current (), upage);
+  if (info == NULL || !info->writable)
     return false;
 
-  kpage = palloc_get_page (PAL_USER);
-  if (kpage == NULL)
+  frame = info->frame;
+  lock_acquire (&frame->lock);
+
+  /* The page maps the zero page.  Give it a frame of its own. */
+  if (frame->kpage == NULL
+      && pagedir_get_page (info->pagedir, upage) == zero_page)
     {
-      victim = swap_find_victim ();
-      vmm_deactivate_frame (victim);
-      kpage = palloc_get_page (PAL_ZERO);
+      kpage = alloc_user_page ();
+      success = kpage != NULL && vmm_activate_frame (frame, kpage);
+      if (success)
+        zero_copy_cnt++;
+      lock_release (&frame->lock);
+      return success;
     }
 
-  if (!vmm_activate_frame (frame, kpage))
-    return false;
+  /* The frame may have been evicted, or the other processes may have let go
+     of it, since the fault.  Or it kept the swap slot it was read from, which
+     is stale once the page is written. */
+  if (pagedir_get_page (info->pagedir, upage) == NULL || !is_shared (frame))
+    {
+      if (frame->kpage != NULL && swap_has_slot (frame))
+        {
+          swap_free_frame (frame);
+          slot_release_cnt++;
+        }
+      update_protection (frame);
+      lock_release (&frame->lock);
+      return true;
+    }
+
+  copy = frame_alloc ();
+  if (copy == NULL)
+    {
+      lock_release (&frame->lock);
+      return false;
+    }
+  frame_init (copy);
+  copy->kpage = alloc_user_page ();
+  if (copy->kpage == NULL)
+    {
+      frame_free (copy);
+      lock_release (&frame->lock);
+      return false;
+    }
+  memcpy (copy->kpage, frame->kpage, PGSIZE);
+  copy->is_stub = false;
+
+  pagedir_clear_page (info->pagedir, upage);
+  list_remove (&info->elem);
+  update_protection (frame);
+
+  list_push_back (&copy->mappings, &info->elem);
+  info->frame = copy;
+  pagedir_set_page (info->pagedir, upage, copy->kpage, true);
+  swap_register_frame (copy);
+  copy_cnt++;
+  fault_note (FAULT_COPY);
 
+  lock_release (&frame->lock);
   return true;
 }
 
-/* Write frame content to disk. */
-void
-vmm_deactivate_frame (struct frame *frame)
+/* Unmap `frame` from every page directory it is installed in, and write it
+   back to its file if it is a dirty file mapping.  Sets `dirty` to whether
+   any mapping was written to.  Returns true if the frame still has to be
+   written to swap space. */
+static bool
+unmap_frame (struct frame *frame, bool *dirty)
 {
-  struct thread *cur;
   struct list_elem *el;
   struct mmap_info *info;
   bool written_to_file, readonly, exe_mapping;
 
-  cur = thread_current ();
-  if (frame->is_stub || frame->is_swapped_out || frame->kpage == NULL)
-    return;
-
+  *dirty = false;
   written_to_file = false;
   readonly = true;
   exe_mapping = false;
@@ -274,33 +1271,188 @@ vmm_deactivate_frame (struct frame *frame)
       info = list_entry (el, struct mmap_info, elem);
       readonly &= !info->writable;
       exe_mapping |= info->exe_mapping;
-      pagedir_clear_page (cur->pagedir, info->upage);
+      pagedir_clear_page (info->pagedir, info->upage);
+      *dirty |= pagedir_is_dirty (info->pagedir, info->upage);
       if (info->file != NULL && !info->exe_mapping
-          && pagedir_is_dirty (cur->pagedir, info->upage))
+          && pagedir_is_dirty (info->pagedir, info->upage))
         {
           ASSERT (!written_to_file);
 
-          file_seek (info->file, info->offset);
-          file_write (info->file, frame->kpage, info->mapped_size);
+          file_write_at (info->file, frame->kpage, info->mapped_size,
+                         info->offset);
           written_to_file = true;
         }
     }
 
-  if (!written_to_file && !(readonly && exe_mapping))
+  return !written_to_file && !(readonly && exe_mapping);
+}
+
+/* Write frame content to disk.  `frame` may belong to any process; its
+   mappings are torn down in their own page directories.  The caller must hold
+   the lock of `frame`.  Returns false if `frame` stays resident because swap
+   space is full. */
+bool
+vmm_deactivate_frame (struct frame *frame)
+{
+  return vmm_deactivate_frames (&frame, 1) == 1;
+}
+
+/* Write the contents of `cnt` frames to disk, at most `SWAP_CLUSTER_PAGES`.
+   Frames that go to swap space are written together with a single request
+   where possible.  Frames that find no room in swap space stay resident.  The
+   caller must hold the locks of all frames.  Returns the number of frames
+   freed. */
+size_t
+vmm_deactivate_frames (struct frame **frames, size_t cnt)
+{
+  struct frame *resident[SWAP_CLUSTER_PAGES], *to_swap[SWAP_CLUSTER_PAGES];
+  struct frame *frame;
+  bool swapping[SWAP_CLUSTER_PAGES];
+  size_t resident_cnt, swap_cnt, freed_cnt, i;
+  bool dirty;
+
+  ASSERT (cnt <= SWAP_CLUSTER_PAGES);
+
+  resident_cnt = swap_cnt = 0;
+  for (i = 0; i < cnt; i++)
+    {
+      frame = frames[i];
+      ASSERT (lock_held_by_current_thread (&frame->lock));
+
+      if (frame->is_stub || frame->is_swapped_out || frame->kpage == NULL)
+        continue;
+
+      if (!frame->prefetched)
+        count_resident_frame (frame, -1);
+      drop_prefetched (frame);
+      frame->is_swapped_out = false;
+      swapping[resident_cnt] = unmap_frame (frame, &dirty);
+      resident[resident_cnt++] = frame;
+
+      /* A frame that kept its slot is written again only if it is dirty,
+         and one reloaded from its file needs no slot at all. */
+      if (dirty || !swapping[resident_cnt - 1])
+        swap_free_frame (frame);
+      if (swapping[resident_cnt - 1])
+        to_swap[swap_cnt++] = frame;
+    }
+
+  swap_write_frames (to_swap, swap_cnt);
+
+  freed_cnt = 0;
+  for (i = 0; i < resident_cnt; i++)
+    {
+      frame = resident[i];
+      if (swapping[i])
+        {
+          /* Swap space is full.  Keep the frame and reinstall its
+             mappings.  `unmap_frame` left their page tables allocated, so
+             this needs no memory and cannot fail, and the page's data
+             would have nowhere else to go if it did. */
+          if (!frame->in_zswap && !swap_has_slot (frame))
+            {
+              if (!install_frame (frame))
+                PANIC ("cannot remap frame that could not be swapped out");
+              continue;
+            }
+          frame->is_swapped_out = true;
+        }
+      palloc_free_page (frame->kpage);
+      frame->kpage = NULL;
+      swap_unregister_frame (frame);
+      freed_cnt++;
+    }
+  return freed_cnt;
+}
+
+/* Returns the stack area of the current process, or NULL if there is
+   none. */
+static struct vma *
+stack_area (void)
+{
+  struct vma *stack;
+
+  stack = vma_find (&thread_current ()->vmas, PHYS_BASE - PGSIZE);
+  return stack != NULL && stack->grows_down ? stack : NULL;
+}
+
+/* Create the stack area of the current process, with its top pages
+   reserved as set by `vmm_set_stack_reserve`, and bring them in ahead of
+   their first touch. */
+bool
+vmm_setup_stack (void)
+{
+  struct vma *stack;
+  size_t page_cnt;
+  void *start;
+
+  page_cnt = stack_initial_pages;
+  if (page_cnt == 0)
+    page_cnt = 1;
+  if (page_cnt > STACK_MAXSIZE / PGSIZE)
+    page_cnt = STACK_MAXSIZE / PGSIZE;
+
+  start = PHYS_BASE - page_cnt * PGSIZE;
+  stack = vmm_create_vma (start, page_cnt, NULL, 0, 0, true, false);
+  if (stack == NULL)
+    return false;
+  stack->grows_down = true;
+  prefault (stack, start, PHYS_BASE);
+  return true;
+}
+
+/* Extend the stack area of the current process down to `upage`, and further
+   down if it has been growing quickly, leaving the guard page below it
+   unmapped.  The new pages are brought in right away. */
+static bool
+grow_stack_area (void *upage)
+{
+  struct thread *cur;
+  struct vma *stack;
+  uint8_t *start, *old_start, *limit;
+  size_t page_cnt;
+
+  cur = thread_current ();
+  stack = stack_area ();
+  if (stack == NULL || upage >= stack->start)
+    return false;
+
+  /* Grow by twice as much as last time if that was only a moment ago. */
+  page_cnt = 1;
+  if (cur->stack_grow_pages > 0
+      && timer_elapsed (cur->stack_grow_ticks) < STACK_BURST_TICKS)
+    page_cnt = cur->stack_grow_pages * 2;
+  if (page_cnt > STACK_GROW_MAX_PAGES)
+    page_cnt = STACK_GROW_MAX_PAGES;
+
+  limit = PHYS_BASE - STACK_MAXSIZE;
+  start = (uint8_t *)upage - (page_cnt - 1) * PGSIZE;
+  if (start < limit)
+    start = limit;
+
+  /* Moving the start of the area down keeps the tree ordered, as long as it
+     and its guard page do not run into another area. */
+  while (vma_find_overlap (&cur->vmas, start - PGSIZE, stack->start) != NULL)
     {
-      swap_write_frame (frame);
-      frame->is_swapped_out = true;
+      if (start == upage)
+        return false;
+      start += PGSIZE;
     }
-  else
-    frame->is_swapped_out = false;
 
-  palloc_free_page (frame->kpage);
-  frame->kpage = NULL;
-  swap_unregister_frame (frame);
+  old_start = stack->start;
+  stack->start = start;
+  prefault (stack, start, old_start);
+
+  cur->stack_grow_pages = (old_start - start) / PGSIZE;
+  cur->stack_grow_ticks = timer_ticks ();
+  stack_grow_cnt++;
+  fault_note (FAULT_STACK);
+  return true;
 }
 
 /* Check if the page fault in `fault_addr` is caused by insufficient stack size
-   using the given `esp`, and grow the stack if possible. */
+   using the given `esp`, and grow the stack if possible.  Accesses more than
+   `STACK_GROW_LIMIT` bytes below `esp` are bugs, not growth. */
 bool
 vmm_grow_stack (void *fault_addr, void *esp)
 {
@@ -309,7 +1461,7 @@ vmm_grow_stack (void *fault_addr, void *esp)
   if (fault_addr < PHYS_BASE - STACK_MAXSIZE)
     return false;
 
-  return vmm_create_anonymous (pg_round_down (fault_addr), true);
+  return grow_stack_area (pg_round_down (fault_addr));
 }
 
 /* Get unused mapping id of current process. */
@@ -355,54 +1507,68 @@ vmm_get_mmap_user_block (mapid_t id)
   return NULL;
 }
 
-/* Populate the chunk list of `block` by mapping file contents to `upage`. */
+/* Map the first `length` bytes of the file of `block` to `upage`.  Only the
+   region is recorded; its pages are read in when they are touched, so this
+   takes the same time for any file size. */
 bool
-vmm_setup_user_block (struct mmap_user_block *block, void *upage)
+vmm_setup_user_block (struct mmap_user_block *block, void *upage,
+                      off_t length)
 {
-  unsigned length, read_bytes, mmap_size, bytes_left;
-  struct mmap_info *info;
-
-  if (pg_ofs (upage) != 0)
+  block->vma = vmm_create_vma (upage, DIV_ROUND_UP (length, PGSIZE),
+                               block->file, 0, length, true, false);
+  if (block->vma == NULL)
     return false;
-
-  length = file_length (block->file);
-  for (read_bytes = 0; read_bytes < length; read_bytes += PGSIZE)
-    {
-      bytes_left = length - read_bytes;
-      mmap_size = bytes_left < PGSIZE ? bytes_left : PGSIZE;
-      info = vmm_create_file_map (upage + read_bytes, block->file, true, false,
-                                  read_bytes, mmap_size);
-      if (info == NULL)
-        {
-          // TODO: add cleanup for mapped pages
-          return false;
-        }
-      list_push_back (&block->chunks, &info->chunk_elem);
-    }
-
+  writeback_register (block->vma);
   return true;
 }
 
-/* Clean up `mmap_user_block` object. */
+/* Write the dirty pages of `block` back to its file.  The caller must hold
+   the file system lock. */
+void
+vmm_sync_user_block (struct mmap_user_block *block)
+{
+  writeback_vma (block->vma);
+}
+
+/* Clean up `mmap_user_block` object.  The caller must hold the file system
+   lock. */
 void
 vmm_cleanup_user_block (struct mmap_user_block *block)
 {
-  struct list_elem *el;
-  struct mmap_info *info;
+  struct list *pages;
 
-  for (el = list_begin (&block->chunks); el != list_end (&block->chunks);
-       el = list_next (el))
-    {
-      info = list_entry (el, struct mmap_info, chunk_elem);
-      vmm_deactivate_frame (info->frame);
-    }
+  /* Once the pages are written back, they can simply be dropped. */
+  writeback_unregister (block->vma);
+  writeback_vma (block->vma);
 
-  while (!list_empty (&block->chunks))
-    {
-      el = list_pop_front (&block->chunks);
-      info = list_entry (el, struct mmap_info, chunk_elem);
-      vmm_remove_mapping (info);
-    }
+  pages = &block->vma->pages;
+  while (!list_empty (pages))
+    vmm_remove_mapping (
+        list_entry (list_front (pages), struct mmap_info, vma_elem));
+
+  vma_remove (&thread_current ()->vmas, block->vma);
+  free (block->vma);
   list_remove (&block->elem);
   free (block);
 }
+
+/* Print statistics of the virtual memory manager. */
+void
+vmm_print_stats (void)
+{
+  printf ("VM: %lld pages read ahead, %lld hits, %lld misses\n",
+          readahead_cnt, readahead_hit_cnt, readahead_miss_cnt);
+  printf ("VM: %lld pages shared copy-on-write, %lld copied\n", share_cnt,
+          copy_cnt);
+  printf ("VM: %lld pages mapped to the zero page, %lld written later\n",
+          zero_map_cnt, zero_copy_cnt);
+  printf ("VM: %lld pages mapped around faults, %lld read from file\n",
+          around_cnt, around_read_cnt);
+  printf ("VM: stack grew %lld times, %lld pages brought in early\n",
+          stack_grow_cnt, prefault_cnt);
+  printf ("VM: %lld large pages mapped, %lld fell back to small pages\n",
+          large_cnt, large_fail_cnt);
+  printf ("VM: %lld frames evicted to enforce resident set limits\n",
+          limit_evict_cnt);
+  printf ("VM: %lld swap slots released on write\n", slot_release_cnt);
+}
@@ -3,32 +3,48 @@
 
 #include "filesys/file.h"
 #include "filesys/off_t.h"
+#include "threads/thread.h"
 #include "user/syscall.h"
 #include "vm/frame.h"
 #include "vm/mmap.h"
+#include "vm/vma.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+void vmm_set_readahead (size_t);
+void vmm_set_fault_around (size_t);
+void vmm_set_stack_reserve (size_t);
+void vmm_set_default_rss_limit (size_t);
+void vmm_set_rss_limit (size_t);
+void vmm_init_zero_page (void);
+void vmm_init_large_pages (void);
 bool vmm_init (void);
 void vmm_destroy (void);
 
 bool vmm_map_to_new_frame (struct mmap_info *);
-struct mmap_info *vmm_create_anonymous (void *, bool);
-struct mmap_info *vmm_create_file_map (void *, struct file *, bool, bool, off_t,
-                                       uint32_t);
+struct vma *vmm_create_vma (void *, size_t, struct file *, off_t, uint32_t,
+                            bool, bool);
 void vmm_remove_mapping (struct mmap_info *);
+bool vmm_fork (struct thread *, struct file *);
 
 struct frame *vmm_lookup_frame (void *);
 bool vmm_activate_frame (struct frame *, void *);
-void vmm_deactivate_frame (struct frame *);
+bool vmm_deactivate_frame (struct frame *);
+size_t vmm_deactivate_frames (struct frame **, size_t);
 
-bool vmm_handle_not_present (void *);
+bool vmm_handle_not_present (void *, bool);
+bool vmm_handle_write_protect (void *);
+bool vmm_setup_stack (void);
 bool vmm_grow_stack (void *, void *);
 
 mapid_t vmm_get_free_mapid (void);
 struct mmap_user_block *vmm_get_mmap_user_block (mapid_t);
-bool vmm_setup_user_block (struct mmap_user_block *, void *);
+bool vmm_setup_user_block (struct mmap_user_block *, void *, off_t);
+void vmm_sync_user_block (struct mmap_user_block *);
 void vmm_cleanup_user_block (struct mmap_user_block *);
 
+void vmm_print_stats (void);
+
 #endif
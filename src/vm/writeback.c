@@ -0,0 +1,223 @@
+#include "vm/writeback.h"
+
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+
+#include <debug.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Writeback of memory-mapped files.
+
+   Every area created by `mmap` is registered here while it exists.  The
+   writeback daemon wakes up every `WRITEBACK_INTERVAL` ticks and writes the
+   dirty pages of all of them back to their files, so that the amount of dirty
+   data stays bounded and munmap and exit find little left to write.  Runs of
+   dirty pages that are adjacent in the file are written with a single
+   request.
+
+   The file system lock must be acquired before `writeback_lock`, which must
+   be acquired before the lock of any frame.  `writeback_lock` also protects
+   the `pages` lists of registered areas, which other threads walk. */
+#define WRITEBACK_INTERVAL TIMER_FREQ
+
+static struct list mapped_vmas; /* Registered areas. */
+static struct lock writeback_lock;
+static uint8_t *cluster_buf; /* Staging area for runs of pages. */
+
+/* Statistics. */
+static long long daemon_run_cnt; /* Number of times daemon ran. */
+static long long page_cnt;       /* Number of pages written back. */
+static long long request_cnt;    /* Number of write requests. */
+
+static thread_func writeback_daemon NO_RETURN;
+
+/* Start the writeback daemon. */
+void
+writeback_init (void)
+{
+  list_init (&mapped_vmas);
+  lock_init (&writeback_lock);
+  cluster_buf = palloc_get_multiple (0, WRITEBACK_CLUSTER_PAGES);
+  thread_create ("writeback", PRI_DEFAULT, writeback_daemon, NULL);
+}
+
+/* Register `vma`, which maps a file writably, for writeback. */
+void
+writeback_register (struct vma *vma)
+{
+  lock_acquire (&writeback_lock);
+  list_push_back (&mapped_vmas, &vma->writeback_elem);
+  lock_release (&writeback_lock);
+}
+
+/* Unregister `vma`.  Afterwards, its pages are only written back by
+   `writeback_vma` or on eviction. */
+void
+writeback_unregister (struct vma *vma)
+{
+  lock_acquire (&writeback_lock);
+  list_remove (&vma->writeback_elem);
+  lock_release (&writeback_lock);
+}
+
+/* Add `info` to the pages of the registered `vma`. */
+void
+writeback_link_page (struct vma *vma, struct mmap_info *info)
+{
+  lock_acquire (&writeback_lock);
+  list_push_back (&vma->pages, &info->vma_elem);
+  lock_release (&writeback_lock);
+}
+
+/* Less function for pages of an area, by address. */
+static bool
+page_less (const struct list_elem *a, const struct list_elem *b,
+           void *aux UNUSED)
+{
+  return list_entry (a, struct mmap_info, vma_elem)->upage
+         < list_entry (b, struct mmap_info, vma_elem)->upage;
+}
+
+/* Returns true if the page of `info` is resident and has been written to
+   since it was last written back.  The caller must hold the lock of its
+   frame. */
+static bool
+is_dirty (const struct mmap_info *info)
+{
+  return info->frame->kpage != NULL
+         && pagedir_is_dirty (info->pagedir, info->upage);
+}
+
+/* Write `cnt` dirty pages in `run`, which are adjacent in their file, back
+   with a single request.  The caller must hold the locks of their frames,
+   which are released here as soon as their contents are copied. */
+static void
+write_run (struct mmap_info **run, size_t cnt)
+{
+  struct mmap_info *info;
+  size_t size, i;
+
+  size = 0;
+  for (i = 0; i < cnt; i++)
+    {
+      info = run[i];
+
+      /* Writes from now on make the page dirty again. */
+      pagedir_set_dirty (info->pagedir, info->upage, false);
+      if (cluster_buf == NULL)
+        file_write_at (info->file, info->frame->kpage, info->mapped_size,
+                       info->offset);
+      else
+        memcpy (cluster_buf + size, info->frame->kpage, info->mapped_size);
+      size += info->mapped_size;
+      lock_release (&info->frame->lock);
+    }
+
+  if (cluster_buf != NULL)
+    file_write_at (run[0]->file, cluster_buf, size, run[0]->offset);
+  page_cnt += cnt;
+  request_cnt += cluster_buf != NULL ? 1 : cnt;
+}
+
+/* Write the dirty pages of `vma` back to its file.  The caller must hold the
+   file system lock and `writeback_lock`. */
+static void
+flush_vma (struct vma *vma)
+{
+  struct mmap_info *run[WRITEBACK_CLUSTER_PAGES], *info, *prev;
+  struct list_elem *el;
+  size_t cnt, max_cnt;
+
+  ASSERT (lock_held_by_current_thread (&writeback_lock));
+
+  max_cnt = cluster_buf != NULL ? WRITEBACK_CLUSTER_PAGES : 1;
+  list_sort (&vma->pages, page_less, NULL);
+
+  cnt = 0;
+  for (el = list_begin (&vma->pages); el != list_end (&vma->pages);
+       el = list_next (el))
+    {
+      info = list_entry (el, struct mmap_info, vma_elem);
+
+      /* End the run at a gap, or when it is full. */
+      if (cnt > 0)
+        {
+          prev = run[cnt - 1];
+          if (cnt == max_cnt || prev->mapped_size != PGSIZE
+              || info->upage != (uint8_t *)prev->upage + PGSIZE)
+            {
+              write_run (run, cnt);
+              cnt = 0;
+            }
+        }
+
+      lock_acquire (&info->frame->lock);
+      if (is_dirty (info))
+        run[cnt++] = info;
+      else
+        {
+          lock_release (&info->frame->lock);
+          if (cnt > 0)
+            {
+              write_run (run, cnt);
+              cnt = 0;
+            }
+        }
+    }
+
+  if (cnt > 0)
+    write_run (run, cnt);
+}
+
+/* Write the dirty pages of `vma` back to its file.  The caller must hold the
+   file system lock. */
+void
+writeback_vma (struct vma *vma)
+{
+  lock_acquire (&writeback_lock);
+  flush_vma (vma);
+  lock_release (&writeback_lock);
+}
+
+/* Periodically write the dirty pages of all registered areas back. */
+static void
+writeback_daemon (void *aux UNUSED)
+{
+  struct list_elem *el;
+
+  for (;;)
+    {
+      timer_sleep (WRITEBACK_INTERVAL);
+
+      /* A stale answer only delays writeback to the next run. */
+      if (list_empty (&mapped_vmas))
+        continue;
+      daemon_run_cnt++;
+
+      thread_acquire_fs_lock ();
+      lock_acquire (&writeback_lock);
+      for (el = list_begin (&mapped_vmas); el != list_end (&mapped_vmas);
+           el = list_next (el))
+        flush_vma (list_entry (el, struct vma, writeback_elem));
+      lock_release (&writeback_lock);
+      thread_release_fs_lock ();
+    }
+}
+
+/* Print statistics of writeback. */
+void
+writeback_print_stats (void)
+{
+  printf ("Writeback: %lld daemon runs, %lld pages written in %lld requests\n",
+          daemon_run_cnt, page_cnt, request_cnt);
+}
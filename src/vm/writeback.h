@@ -0,0 +1,17 @@
+#ifndef VM_WRITEBACK_H
+#define VM_WRITEBACK_H
+
+#include "vm/mmap.h"
+#include "vm/vma.h"
+
+/* Maximum number of pages written back with a single request. */
+#define WRITEBACK_CLUSTER_PAGES 8
+
+void writeback_init (void);
+void writeback_register (struct vma *);
+void writeback_unregister (struct vma *);
+void writeback_link_page (struct vma *, struct mmap_info *);
+void writeback_vma (struct vma *);
+void writeback_print_stats (void);
+
+#endif
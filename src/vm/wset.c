@@ -0,0 +1,107 @@
+#include "vm/wset.h"
+
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/swap.h"
+
+#include <debug.h>
+#include <list.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Working set sampler.
+
+   Every `WSET_INTERVAL` ticks, the sampler walks the resident frames of all
+   processes and credits every mapping accessed since the last walk to the
+   working set of its process.  The working set of a process is the number of
+   its pages referenced during the last period.  The accessed bits are cleared
+   for the next period, but kept in `referenced` of the frame, so that the
+   replacement policy still sees them. */
+#define WSET_INTERVAL (TIMER_FREQ / 4)
+
+/* Statistics. */
+static long long sample_cnt; /* Number of sampling periods. */
+static size_t peak_rss;      /* Largest resident set seen. */
+static size_t peak_wss;      /* Largest working set seen. */
+
+static thread_func wset_daemon NO_RETURN;
+
+/* Start the working set sampler. */
+void
+wset_init (void)
+{
+  thread_create ("wset", PRI_DEFAULT, wset_daemon, NULL);
+}
+
+/* Credit the mappings of `frame` that were accessed to the working sets of
+   their processes.  A busy frame is skipped; it is being brought in or
+   evicted anyway. */
+static void
+sample_frame (struct frame *frame, void *aux UNUSED)
+{
+  struct list_elem *el;
+  struct mmap_info *info;
+
+  if (!lock_try_acquire (&frame->lock))
+    return;
+
+  if (!frame->prefetched)
+    for (el = list_begin (&frame->mappings);
+         el != list_end (&frame->mappings); el = list_next (el))
+      {
+        info = list_entry (el, struct mmap_info, elem);
+        if (!pagedir_is_accessed (info->pagedir, info->upage))
+          continue;
+
+        pagedir_set_accessed (info->pagedir, info->upage, false);
+        frame->referenced = true;
+        info->owner->wss_sample++;
+      }
+
+  lock_release (&frame->lock);
+}
+
+/* End the sampling period of `t`. */
+static void
+end_period (struct thread *t, void *aux UNUSED)
+{
+  t->wss = t->wss_sample;
+  t->wss_sample = 0;
+  if (t->wss > peak_wss)
+    peak_wss = t->wss;
+  if (t->rss > peak_rss)
+    peak_rss = t->rss;
+}
+
+/* Sample the working sets of all processes periodically. */
+static void
+wset_daemon (void *aux UNUSED)
+{
+  enum intr_level old_level;
+
+  for (;;)
+    {
+      timer_sleep (WSET_INTERVAL);
+
+      swap_for_each_frame (sample_frame, NULL);
+
+      old_level = intr_disable ();
+      thread_foreach (end_period, NULL);
+      intr_set_level (old_level);
+      sample_cnt++;
+    }
+}
+
+/* Print statistics of the working set sampler. */
+void
+wset_print_stats (void)
+{
+  printf ("Wset: %lld samples, peak RSS %zu pages, peak working set %zu "
+          "pages\n",
+          sample_cnt, peak_rss, peak_wss);
+}
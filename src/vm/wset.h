@@ -0,0 +1,7 @@
+#ifndef VM_WSET_H
+#define VM_WSET_H
+
+void wset_init (void);
+void wset_print_stats (void);
+
+#endif
@@ -0,0 +1,346 @@
+#include "vm/zswap.h"
+
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Compressed swap pool.
+
+   Evicted pages are kept in memory, in front of the swap device, as long as
+   they can be stored cheaply.  A page filled with a single repeated word
+   takes no memory beyond its frame.  Other pages are compressed and kept in
+   pool pages taken from the user pool, two to a page: one from the start and
+   one from the end.  Pages that do not compress to half a page, or that
+   would grow the pool beyond its limit, go to the swap device instead. */
+
+/* Header at the start of every pool page. */
+struct zpage
+{
+  struct list_elem elem; /* Element for `unbuddied` list. */
+  uint16_t first_size;   /* Size of object at the start, 0 if none. */
+  uint16_t last_size;    /* Size of object at the end, 0 if none. */
+};
+
+#define ZPAGE_HDR_SIZE ROUND_UP (sizeof (struct zpage), 8)
+#define ZPAGE_ROOM (PGSIZE - ZPAGE_HDR_SIZE)
+#define ZSWAP_MAX_SIZE (ZPAGE_ROOM / 2)
+
+/* Compression. */
+#define HASH_BITS 12
+#define MAX_OFFSET 4095
+#define MIN_MATCH 3
+#define MAX_MATCH (MIN_MATCH + 15)
+
+static size_t pool_limit;    /* Maximum number of pool pages. */
+static size_t pool_cnt;      /* Number of pool pages in use. */
+static struct list unbuddied; /* Pool pages with one object. */
+static struct lock zswap_lock;
+
+/* Scratch space for compression, protected by `zswap_lock`. */
+static uint16_t match_table[1 << HASH_BITS];
+static uint8_t compress_buf[ZSWAP_MAX_SIZE];
+
+/* Statistics. */
+static long long same_filled_cnt; /* Same-filled pages stored. */
+static long long compressed_cnt;  /* Compressed pages stored. */
+static long long rejected_cnt;    /* Pages passed on to the swap device. */
+static long long load_cnt;        /* Pages loaded back. */
+
+/* Set the maximum size of the compressed pool to `limit` pages.  Zero
+   keeps only same-filled pages in memory. */
+void
+zswap_set_limit (size_t limit)
+{
+  pool_limit = limit;
+}
+
+/* Initialize compressed swap pool. */
+void
+zswap_init (void)
+{
+  lock_init (&zswap_lock);
+  list_init (&unbuddied);
+}
+
+/* Returns true if the page at `kpage` consists of one repeated word, and
+   stores the word into `word`. */
+static bool
+is_same_filled (const void *kpage, uint32_t *word)
+{
+  const uint32_t *p = kpage;
+  size_t i;
+
+  for (i = 1; i < PGSIZE / sizeof *p; i++)
+    if (p[i] != p[0])
+      return false;
+  *word = p[0];
+  return true;
+}
+
+/* Compress the page at `src` into `dst`, which holds `dst_max` bytes, with a
+   variant of LZRW1: a 16-bit control word precedes every 16 items, each of
+   which is either a literal byte or a 2-byte copy of 3 to 18 bytes from up to
+   4095 bytes back.  Returns the compressed size, or 0 if it does not fit. */
+static size_t
+compress_page (const uint8_t *src, uint8_t *dst, size_t dst_max)
+{
+  size_t ip, op, ctrl_pos, cand, len, off;
+  unsigned ctrl, bit, hash;
+
+  ip = op = 0;
+  while (ip < PGSIZE)
+    {
+      if (op + 2 > dst_max)
+        return 0;
+      ctrl_pos = op;
+      op += 2;
+      ctrl = 0;
+
+      for (bit = 0; bit < 16 && ip < PGSIZE; bit++)
+        {
+          if (op + 2 > dst_max)
+            return 0;
+
+          /* Stale table entries are harmless: every match is verified. */
+          if (ip + MIN_MATCH <= PGSIZE)
+            {
+              hash = ((src[ip] << 8) ^ (src[ip + 1] << 4) ^ src[ip + 2])
+                     * 40543U;
+              hash = (hash >> 4) & ((1 << HASH_BITS) - 1);
+              cand = match_table[hash];
+              match_table[hash] = ip;
+              off = ip - cand;
+              if (cand < ip && off <= MAX_OFFSET && src[cand] == src[ip]
+                  && src[cand + 1] == src[ip + 1]
+                  && src[cand + 2] == src[ip + 2])
+                {
+                  len = MIN_MATCH;
+                  while (len < MAX_MATCH && ip + len < PGSIZE
+                         && src[cand + len] == src[ip + len])
+                    len++;
+                  dst[op++] = off & 0xff;
+                  dst[op++] = ((off >> 8) << 4) | (len - MIN_MATCH);
+                  ctrl |= 1 << bit;
+                  ip += len;
+                  continue;
+                }
+            }
+          dst[op++] = src[ip++];
+        }
+
+      dst[ctrl_pos] = ctrl & 0xff;
+      dst[ctrl_pos + 1] = ctrl >> 8;
+    }
+  return op;
+}
+
+/* Decompress `size` bytes at `src` produced by `compress_page` into the page
+   at `dst`. */
+static void
+decompress_page (const uint8_t *src, size_t size, uint8_t *dst)
+{
+  size_t ip, op, len, off;
+  unsigned ctrl, bit;
+
+  ip = op = 0;
+  while (ip < size)
+    {
+      ctrl = src[ip] | (src[ip + 1] << 8);
+      ip += 2;
+      for (bit = 0; bit < 16 && ip < size; bit++)
+        if (ctrl & (1 << bit))
+          {
+            off = src[ip] | ((src[ip + 1] >> 4) << 8);
+            len = (src[ip + 1] & 0xf) + MIN_MATCH;
+            ip += 2;
+            for (; len > 0; len--, op++)
+              dst[op] = dst[op - off];
+          }
+        else
+          dst[op++] = src[ip++];
+    }
+  ASSERT (op == PGSIZE);
+}
+
+/* Find room for an object of `size` bytes in the pool and return its
+   address, or NULL if the pool is full. */
+static uint8_t *
+pool_alloc (size_t size)
+{
+  struct list_elem *el;
+  struct zpage *zp;
+
+  for (el = list_begin (&unbuddied); el != list_end (&unbuddied);
+       el = list_next (el))
+    {
+      zp = list_entry (el, struct zpage, elem);
+      if (zp->first_size + zp->last_size + size > ZPAGE_ROOM)
+        continue;
+      list_remove (&zp->elem);
+      if (zp->first_size == 0)
+        {
+          zp->first_size = size;
+          return (uint8_t *)zp + ZPAGE_HDR_SIZE;
+        }
+      zp->last_size = size;
+      return (uint8_t *)zp + PGSIZE - size;
+    }
+
+  if (pool_cnt >= pool_limit)
+    return NULL;
+  zp = palloc_get_page (PAL_USER);
+  if (zp == NULL)
+    return NULL;
+  pool_cnt++;
+  zp->first_size = size;
+  zp->last_size = 0;
+  list_push_back (&unbuddied, &zp->elem);
+  return (uint8_t *)zp + ZPAGE_HDR_SIZE;
+}
+
+/* Returns the size of the object at `data` in the pool. */
+static size_t
+pool_size (const uint8_t *data)
+{
+  const struct zpage *zp = pg_round_down (data);
+
+  return data == (const uint8_t *)zp + ZPAGE_HDR_SIZE ? zp->first_size
+                                                       : zp->last_size;
+}
+
+/* Free the object at `data` in the pool. */
+static void
+pool_free (uint8_t *data)
+{
+  struct zpage *zp = pg_round_down (data);
+  bool was_full;
+
+  was_full = zp->first_size != 0 && zp->last_size != 0;
+  if (data == (uint8_t *)zp + ZPAGE_HDR_SIZE)
+    zp->first_size = 0;
+  else
+    zp->last_size = 0;
+
+  if (zp->first_size == 0 && zp->last_size == 0)
+    {
+      list_remove (&zp->elem);
+      palloc_free_page (zp);
+      pool_cnt--;
+    }
+  else if (was_full)
+    list_push_back (&unbuddied, &zp->elem);
+}
+
+/* Store the contents of resident `frame` in the pool.  Returns false if it
+   has to go to the swap device instead.  The caller must hold the lock of
+   `frame`. */
+bool
+zswap_store (struct frame *frame)
+{
+  uint32_t word;
+  size_t size;
+  uint8_t *data;
+
+  ASSERT (frame->kpage != NULL);
+  ASSERT (!frame->in_zswap);
+
+  if (is_same_filled (frame->kpage, &word))
+    {
+      frame->in_zswap = true;
+      frame->zswap_data = NULL;
+      frame->zswap_word = word;
+      lock_acquire (&zswap_lock);
+      same_filled_cnt++;
+      lock_release (&zswap_lock);
+      return true;
+    }
+
+  if (pool_limit == 0)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  data = NULL;
+  size = compress_page (frame->kpage, compress_buf, sizeof compress_buf);
+  if (size != 0)
+    data = pool_alloc (size);
+  if (data == NULL)
+    {
+      rejected_cnt++;
+      lock_release (&zswap_lock);
+      return false;
+    }
+  memcpy (data, compress_buf, size);
+  compressed_cnt++;
+  lock_release (&zswap_lock);
+
+  frame->in_zswap = true;
+  frame->zswap_data = data;
+  return true;
+}
+
+/* Restore the contents of `frame` from the pool into its page, and drop them
+   from the pool.  The caller must hold the lock of `frame`. */
+void
+zswap_load (struct frame *frame)
+{
+  uint32_t *p;
+  size_t i;
+
+  ASSERT (frame->in_zswap);
+  ASSERT (frame->kpage != NULL);
+
+  lock_acquire (&zswap_lock);
+  if (frame->zswap_data == NULL)
+    {
+      p = frame->kpage;
+      for (i = 0; i < PGSIZE / sizeof *p; i++)
+        p[i] = frame->zswap_word;
+    }
+  else
+    {
+      decompress_page (frame->zswap_data, pool_size (frame->zswap_data),
+                       frame->kpage);
+      pool_free (frame->zswap_data);
+    }
+  load_cnt++;
+  lock_release (&zswap_lock);
+
+  frame->in_zswap = false;
+  frame->zswap_data = NULL;
+}
+
+/* Drop the contents of `frame` from the pool.  The caller must hold the
+   lock of `frame`. */
+void
+zswap_free (struct frame *frame)
+{
+  ASSERT (frame->in_zswap);
+
+  if (frame->zswap_data != NULL)
+    {
+      lock_acquire (&zswap_lock);
+      pool_free (frame->zswap_data);
+      lock_release (&zswap_lock);
+    }
+  frame->in_zswap = false;
+  frame->zswap_data = NULL;
+}
+
+/* Print statistics of the compressed swap pool. */
+void
+zswap_print_stats (void)
+{
+  printf ("Zswap: %lld same-filled and %lld compressed pages stored, "
+          "%lld rejected, %lld loaded, %zu pool pages\n",
+          same_filled_cnt, compressed_cnt, rejected_cnt, load_cnt, pool_cnt);
+}
@@ -0,0 +1,16 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include "vm/frame.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void zswap_set_limit (size_t);
+void zswap_init (void);
+bool zswap_store (struct frame *);
+void zswap_load (struct frame *);
+void zswap_free (struct frame *);
+void zswap_print_stats (void);
+
+#endif